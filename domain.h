@@ -13,6 +13,8 @@ struct Stop {
     explicit Stop(std::string name, geo::Coordinates coordinates);
     std::string name;
     geo::Coordinates coordinates;
+    // Номер в справочнике: остановки нумеруются подряд с нуля в порядке добавления
+    size_t id = 0;
 };
 
 struct Bus {
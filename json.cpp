@@ -23,7 +23,7 @@ bool Node::IsPureDouble() const {
 }
 
 bool Node::IsString() const {
-    return std::holds_alternative<std::string>(*this);
+    return std::holds_alternative<String>(*this);
 }
 
 bool Node::IsBool() const {
@@ -56,11 +56,11 @@ double Node::AsDouble() const {
     return IsPureDouble() ? std::get<double>(*this) : AsInt();
 }
 
-const std::string& Node::AsString() const {
+const String& Node::AsString() const {
     if (!IsString()) {
         throw std::logic_error("Not a string"s);
     }
-    return std::get<std::string>(*this);
+    return std::get<String>(*this);
 }
 
 bool Node::AsBool() const {
@@ -96,17 +96,33 @@ bool operator!=(const Node& lhs, const Node& rhs) {
 
 namespace {
 
-Node LoadNode(std::istream& input);
+// Без noexcept-перемещения вектор при росте копировал бы узлы, и копии
+// уходили бы из арены в ресурс по умолчанию
+static_assert(std::is_nothrow_move_constructible_v<Node>);
+
+/*
+ * Контекст загрузки: поток ввода, ресурс памяти, из которого выделяются
+ * все контейнеры и строки документа, и общий буфер, в который
+ * разбирается очередная строка
+ */
+struct LoadContext {
+    std::istream& input;
+    std::pmr::memory_resource* resource;
+    std::string& buffer;
+};
+
+Node LoadNode(const LoadContext& ctx);
 
-Node LoadArray(std::istream& input) {
-    Array result;
+Node LoadArray(const LoadContext& ctx) {
+    std::istream& input = ctx.input;
+    Array result(ctx.resource);
     for (char c; input >> c && c != ']';) {
         if (c != ',') {
             input.putback(c);
         }
-        result.push_back(LoadNode(input));
+        result.push_back(LoadNode(ctx));
     }
-    return Node(move(result));
+    return Node(std::move(result));
 }
 
 char EscapeChar(char c) {
@@ -126,8 +142,9 @@ char EscapeChar(char c) {
     }
 }
 
-Node LoadString(std::istream& input) {
-    std::string line{};
+// Разбирает строку в буфер. Результат действителен до следующего разбора в этот буфер
+std::string_view ParseString(std::istream& input, std::string& line) {
+    line.clear();
     for (char c; input.get(c) && (c != '\"');) {
         if (c == '\\') {
             input.get(c);
@@ -139,23 +156,33 @@ Node LoadString(std::istream& input) {
     if (input.eof()) {
         throw ParsingError("Missing closing \""s);
     }
-    return Node(move(line));
+    return line;
 }
 
-Node LoadDict(std::istream& input) {
-    Dict result;
+std::string_view ParseString(const LoadContext& ctx) {
+    return ParseString(ctx.input, ctx.buffer);
+}
+
+Node LoadString(const LoadContext& ctx) {
+    return Node(String(ParseString(ctx), ctx.resource));
+}
+
+Node LoadDict(const LoadContext& ctx) {
+    std::istream& input = ctx.input;
+    Dict result(ctx.resource);
 
     for (char c; input >> c && c != '}';) {
         if (c == ',') {
             input >> c;
         }
 
-        std::string key = LoadString(input).AsString();
+        // Ключ копируется из буфера до разбора значения, которое его перезапишет
+        String key(ParseString(ctx), ctx.resource);
         input >> c;
-        result.insert({move(key), LoadNode(input)});
+        result.emplace(std::move(key), LoadNode(ctx));
     }
 
-    return Node(move(result));
+    return Node(std::move(result));
 }
 
 Node LoadNull(std::istream& input) {
@@ -251,7 +278,8 @@ Node LoadNumber(std::istream& input) {
             : Node(std::move(std::get<double>(number)));
 }
 
-Node LoadNode(std::istream& input) {
+Node LoadNode(const LoadContext& ctx) {
+    std::istream& input = ctx.input;
     char c;
     if (!(input >> c)) {
         throw ParsingError("Unexpected EOF"s);
@@ -259,11 +287,11 @@ Node LoadNode(std::istream& input) {
 
     switch (c) {
         case '[':
-            return LoadArray(input);
+            return LoadArray(ctx);
         case '{':
-            return LoadDict(input);
+            return LoadDict(ctx);
         case '"':
-            return LoadString(input);
+            return LoadString(ctx);
         case 't':
             [[fallthrough]];
         case 'f':
@@ -278,19 +306,57 @@ Node LoadNode(std::istream& input) {
     }
 }
 
+Node LoadRoot(std::istream& input, std::pmr::memory_resource* resource) {
+    std::string buffer;
+    return LoadNode(LoadContext{input, resource, buffer});
+}
+
+// Пропускает пробельные символы и считывает очередной символ
+char ReadToken(std::istream& input) {
+    char c;
+    if (!(input >> c)) {
+        throw ParsingError("Unexpected EOF"s);
+    }
+    return c;
+}
+
+void ExpectToken(std::istream& input, char expected) {
+    if (ReadToken(input) != expected) {
+        throw ParsingError("Expected '"s + expected + "'"s);
+    }
+}
+
 struct PrintContext {
     std::ostream& out;
+    PrintMode mode = PrintMode::PRETTY;
     int indent_step = 4;
     int indent = 0;
 
+    bool IsCompact() const {
+        return mode == PrintMode::COMPACT;
+    }
+
     void PrintIndent() const {
+        if (IsCompact()) {
+            return;
+        }
         for (int i = 0; i < indent; ++i) {
             out.put(' ');
         }
     }
 
+    void PrintNewLine() const {
+        if (!IsCompact()) {
+            out.put('\n');
+        }
+    }
+
+    void PrintKeySeparator() const {
+        out << (IsCompact() ? ":"sv : ": "sv);
+    }
+
     PrintContext Indented() const {
-        return {out, indent_step, indent_step + indent};
+        return {out, mode, indent_step, indent_step + indent};
     }
 };
 
@@ -301,7 +367,7 @@ void PrintValue(const Value& value, const PrintContext& ctx) {
     ctx.out << value;
 }
 
-void PrintString(const std::string& value, std::ostream& out) {
+void PrintString(std::string_view value, std::ostream& out) {
     out.put('"');
     for (const char c : value) {
         switch (c) {
@@ -326,7 +392,7 @@ void PrintString(const std::string& value, std::ostream& out) {
 }
 
 template <>
-void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
+void PrintValue<String>(const String& value, const PrintContext& ctx) {
     PrintString(value, ctx.out);
 }
 
@@ -347,19 +413,21 @@ void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
 template <>
 void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
     std::ostream& out = ctx.out;
-    out << "[\n"sv;
+    out.put('[');
+    ctx.PrintNewLine();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const Node& node : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.put(',');
+            ctx.PrintNewLine();
         }
         inner_ctx.PrintIndent();
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintNewLine();
     ctx.PrintIndent();
     out.put(']');
 }
@@ -367,21 +435,23 @@ void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
 template <>
 void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
     std::ostream& out = ctx.out;
-    out << "{\n"sv;
+    out.put('{');
+    ctx.PrintNewLine();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const auto& [key, node] : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.put(',');
+            ctx.PrintNewLine();
         }
         inner_ctx.PrintIndent();
         PrintString(key, ctx.out);
-        out << ": "sv;
+        ctx.PrintKeySeparator();
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintNewLine();
     ctx.PrintIndent();
     out.put('}');
 }
@@ -397,11 +467,15 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
 }  // namespace
 
 Document::Document(Node root)
-    : root_(move(root)) {
+    : root_(std::make_shared<const Node>(std::move(root))) {
+}
+
+Document::Document(std::shared_ptr<const Node> root)
+    : root_(std::move(root)) {
 }
 
 const Node& Document::GetRoot() const {
-    return root_;
+    return *root_;
 }
 
 bool operator==(const Document& lhs, const Document& rhs) {
@@ -413,11 +487,124 @@ bool operator!=(const Document& lhs, const Document& rhs) {
 }
 
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    auto arena = std::make_shared<std::pmr::monotonic_buffer_resource>();
+    Node root = LoadRoot(input, arena.get());
+    // Корень тоже размещается в арене, и деструкторы узлов не вызываются:
+    // вся память документа освобождается вместе с ареной
+    Node* root_ptr = new (arena->allocate(sizeof(Node), alignof(Node))) Node(std::move(root));
+    return Document{std::shared_ptr<const Node>(std::move(arena), root_ptr)};
+}
+
+Document Load(std::istream& input, std::pmr::memory_resource* resource) {
+    return Document{LoadRoot(input, resource)};
+}
+
+// ---------- Parser ------------------
+
+Parser::Parser(std::istream& input)
+    : input_(input) {
+}
+
+void Parser::StartDict() {
+    ExpectToken(input_, '{');
+}
+
+void Parser::StartArray() {
+    ExpectToken(input_, '[');
+}
+
+std::optional<std::string_view> Parser::NextKey() {
+    char c = ReadToken(input_);
+    if (c == '}') {
+        return std::nullopt;
+    }
+    if (c == ',') {
+        c = ReadToken(input_);
+    }
+    if (c != '"') {
+        throw ParsingError("Dict key is expected"s);
+    }
+    ParseString(input_, key_);
+    ExpectToken(input_, ':');
+    return key_;
+}
+
+std::optional<Symbol> Parser::NextSymbolKey() {
+    if (const auto key = NextKey()) {
+        return Intern(*key);
+    }
+    return std::nullopt;
+}
+
+bool Parser::NextItem() {
+    const char c = ReadToken(input_);
+    if (c == ']') {
+        return false;
+    }
+    if (c != ',') {
+        input_.putback(c);
+    }
+    return true;
+}
+
+bool Parser::IsNextString() {
+    return (input_ >> std::ws).peek() == '"';
+}
+
+std::string Parser::ReadString() {
+    ExpectToken(input_, '"');
+    return std::string(ParseString(input_, value_));
+}
+
+Symbol Parser::ReadSymbol() {
+    ExpectToken(input_, '"');
+    return Intern(ParseString(input_, value_));
+}
+
+int Parser::ReadInt() {
+    input_ >> std::ws;
+    const Number number = ParseNumber(input_);
+    if (!std::holds_alternative<int>(number)) {
+        throw ParsingError("Integer is expected"s);
+    }
+    return std::get<int>(number);
+}
+
+double Parser::ReadDouble() {
+    input_ >> std::ws;
+    const Number number = ParseNumber(input_);
+    return std::holds_alternative<int>(number) ? std::get<int>(number) : std::get<double>(number);
+}
+
+bool Parser::ReadBool() {
+    return LoadBool(input_).AsBool();
+}
+
+Node Parser::ReadNode() {
+    return LoadRoot(input_, std::pmr::get_default_resource());
+}
+
+void Parser::SkipValue() {
+    ReadNode();
+}
+
+size_t Parser::SymbolCount() const {
+    return symbol_ids_.size();
+}
+
+Symbol Parser::Intern(std::string_view text) {
+    if (const auto it = symbol_ids_.find(text); it != symbol_ids_.end()) {
+        return Symbol{it->first, it->second};
+    }
+    char* data = static_cast<char*>(symbols_resource_.allocate(text.size(), alignof(char)));
+    text.copy(data, text.size());
+    const Symbol symbol{std::string_view(data, text.size()), symbol_ids_.size()};
+    symbol_ids_.emplace(symbol.text, symbol.id);
+    return symbol;
 }
 
-void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+void Print(const Document& doc, std::ostream& output, PrintMode mode) {
+    PrintNode(doc.GetRoot(), PrintContext{output, mode});
 }
 
 }  // namespace json
@@ -2,15 +2,23 @@
 
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 
 namespace json {
 
 class Node;
-using Dict = std::map<std::string, Node>;
-using Array = std::vector<Node>;
+// Контейнеры узлов используют полиморфные аллокаторы, чтобы документ целиком
+// можно было разместить в одной арене (см. Load)
+using String = std::pmr::string;
+using Dict = std::pmr::map<String, Node, std::less<>>;
+using Array = std::pmr::vector<Node>;
 
 // Эта ошибка должна выбрасываться при ошибках парсинга JSON
 class ParsingError : public std::runtime_error {
@@ -19,7 +27,7 @@ public:
 };
 
 class Node final
-    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string> {
+    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, String> {
 public:
     using variant::variant;
     using Value = variant;
@@ -36,7 +44,7 @@ public:
     const Value& GetValue() const;
     int AsInt() const;
     double AsDouble() const;
-    const std::string& AsString() const;
+    const String& AsString() const;
     bool AsBool() const;
     const Array& AsArray() const;
     const Dict& AsDict() const;
@@ -52,14 +60,93 @@ public:
     const Node& GetRoot() const;
 
 private:
-    Node root_;
+    // Корень может разделять владение с ареной, в которой размещён документ
+    explicit Document(std::shared_ptr<const Node> root);
+
+    std::shared_ptr<const Node> root_;
+
+    friend Document Load(std::istream& input);
 };
 
 bool operator==(const Document& lhs, const Document& rhs);
 bool operator!=(const Document& lhs, const Document& rhs);
 
+// Загружает документ в собственную монотонную арену: все узлы, массивы, словари
+// и строки выделяются из неё, а разрушение документа сводится к освобождению арены
 Document Load(std::istream& input);
 
-void Print(const Document& doc, std::ostream& output);
+// Загружает документ, выделяя память под узлы из переданного ресурса.
+// Ресурс должен пережить документ
+Document Load(std::istream& input, std::pmr::memory_resource* resource);
+
+// Строка, интернированная Parser. Одинаковые строки документа хранятся один раз
+// и получают один id; id нумеруются подряд с нуля
+struct Symbol {
+    std::string_view text;
+    size_t id = 0;
+};
+
+/*
+ * Разбор JSON по схеме без построения узлов: вызывающий код сам знает,
+ * какое значение ожидается следующим, и считывает его сразу в нужный тип.
+ * Строки, которые нужно сохранить после разбора (имена, на которые ссылаются
+ * другие объекты документа), интернируются в таблицу символов парсера
+ * и действительны, пока жив парсер. По id символа ссылки можно разрешать
+ * индексом в массиве, не сравнивая строки
+ */
+class Parser {
+public:
+    explicit Parser(std::istream& input);
+
+    void StartDict();
+    void StartArray();
+
+    // Считывает очередной ключ словаря и разделитель после него.
+    // Возвращает nullopt, когда словарь закончился.
+    // Ключ действителен до следующего вызова NextKey
+    std::optional<std::string_view> NextKey();
+    // То же, но ключ интернируется: для словарей, ключи которых — данные,
+    // а не имена полей
+    std::optional<Symbol> NextSymbolKey();
+
+    // Возвращает false, когда массив закончился
+    bool NextItem();
+
+    bool IsNextString();
+
+    std::string ReadString();
+    // Считывает строку и интернирует её
+    Symbol ReadSymbol();
+    int ReadInt();
+    // Принимает и целые, и дробные числа
+    double ReadDouble();
+    bool ReadBool();
+    // Считывает произвольное значение в узел
+    Node ReadNode();
+    void SkipValue();
+
+    // Число интернированных строк: id всех символов меньше него
+    size_t SymbolCount() const;
+
+private:
+    std::istream& input_;
+    std::string key_;
+    std::string value_;
+    // Текст символов и узлы таблицы выделяются подряд из арены парсера
+    // и не перемещаются, пока жив парсер
+    std::pmr::monotonic_buffer_resource symbols_resource_;
+    std::pmr::unordered_map<std::string_view, size_t> symbol_ids_{&symbols_resource_};
+
+    Symbol Intern(std::string_view text);
+};
+
+// PRETTY выводит каждый элемент с новой строки с отступом в 4 пробела,
+// COMPACT выводит документ без пробельных символов
+enum class PrintMode {
+    PRETTY,
+    COMPACT,
+};
+
+void Print(const Document& doc, std::ostream& output, PrintMode mode = PrintMode::PRETTY);
 
 }  // namespace json
@@ -1,17 +1,33 @@
 #include "json_reader.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
-#include <vector>
 #include <string_view>
-#include <iomanip>
-#include <cstdlib>
-#include <memory>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include "geo.h"
 #include "domain.h"
-#include "json_builder.h"
+#include "json_writer.h"
+#include "profiler.h"
+#include "ranges.h"
+#include "spsc_queue.h"
 
 namespace json_reader {
 
@@ -20,224 +36,1245 @@ using namespace json;
 using domain::Stop;
 using domain::Bus;
 
-JsonReader::JsonReader(std::istream& in, std::ostream& out)
-    : document_(json::Load(in)), out_(out) {
+namespace {
+
+// Ключи всех объектов входного документа
+enum class Field {
+    BASE_REQUESTS,
+    RENDER_SETTINGS,
+    ROUTING_SETTINGS,
+    STAT_REQUESTS,
+    OUTPUT_SETTINGS,
+    TYPE,
+    NAME,
+    LATITUDE,
+    LONGITUDE,
+    ROAD_DISTANCES,
+    STOPS,
+    IS_ROUNDTRIP,
+    ID,
+    FROM,
+    TO,
+    WIDTH,
+    HEIGHT,
+    PADDING,
+    LINE_WIDTH,
+    STOP_RADIUS,
+    BUS_LABEL_FONT_SIZE,
+    BUS_LABEL_OFFSET,
+    STOP_LABEL_FONT_SIZE,
+    STOP_LABEL_OFFSET,
+    UNDERLAYER_COLOR,
+    UNDERLAYER_WIDTH,
+    COLOR_PALETTE,
+    PRECISION,
+    CSS_CLASSES,
+    SIMPLIFY_TOLERANCE,
+    BBOX,
+    TILE,
+    BUS_WAIT_TIME,
+    BUS_VELOCITY,
+    COMPACT,
+    COUNT,
+};
+
+// Имена ключей в порядке перечисления Field
+const std::array<std::string_view, static_cast<size_t>(Field::COUNT)> FIELD_NAMES = {
+    "base_requests"sv, "render_settings"sv, "routing_settings"sv, "stat_requests"sv,
+    "output_settings"sv, "type"sv, "name"sv, "latitude"sv, "longitude"sv, "road_distances"sv,
+    "stops"sv, "is_roundtrip"sv, "id"sv, "from"sv, "to"sv, "width"sv, "height"sv, "padding"sv,
+    "line_width"sv, "stop_radius"sv, "bus_label_font_size"sv, "bus_label_offset"sv,
+    "stop_label_font_size"sv, "stop_label_offset"sv, "underlayer_color"sv,
+    "underlayer_width"sv, "color_palette"sv, "precision"sv, "css_classes"sv,
+    "simplify_tolerance"sv, "bbox"sv, "tile"sv, "bus_wait_time"sv, "bus_velocity"sv,
+    "compact"sv,
+};
+
+std::optional<Field> FindField(std::string_view key) {
+    static const auto fields = [] {
+        std::unordered_map<std::string_view, Field> result;
+        for (size_t i = 0; i < FIELD_NAMES.size(); ++i) {
+            result.emplace(FIELD_NAMES[i], static_cast<Field>(i));
+        }
+        return result;
+    }();
+    if (const auto it = fields.find(key); it != fields.end()) {
+        return it->second;
+    }
+    return std::nullopt;
 }
 
-void ParseStop(const Dict& stop_info, catalogue::TransportCatalogue& catalogue) {
-    const std::string& name = stop_info.at("name"s).AsString();
-    const double& lat = stop_info.at("latitude"s).AsDouble();
-    const double& lng = stop_info.at("longitude"s).AsDouble();
-    catalogue.AddStop(Stop(name, geo::Coordinates{lat, lng}));
+// Множество встреченных ключей объекта, по одному биту на Field
+using FieldSet = uint64_t;
+
+constexpr FieldSet Bit(Field field) {
+    return FieldSet{1} << static_cast<int>(field);
+}
+
+template <typename... Fields>
+constexpr FieldSet Bits(Fields... fields) {
+    return (Bit(fields) | ...);
 }
 
-void SetDistance(const Node* stop_info_node, catalogue::TransportCatalogue& catalogue) {
-    if (stop_info_node->IsNull()) {
+void CheckRequired(FieldSet seen, FieldSet required, std::string_view object) {
+    const FieldSet missing = required & ~seen;
+    if (missing == 0) {
         return;
     }
-    const Dict& stop_info = stop_info_node->AsDict();
-    if (stop_info.count("road_distances"s) == 0) {
-        return;
+    for (size_t i = 0; i < FIELD_NAMES.size(); ++i) {
+        if (missing & Bit(static_cast<Field>(i))) {
+            throw ParsingError(std::string(object) + ": missing \""s
+                    + std::string(FIELD_NAMES[i]) + "\""s);
+        }
+    }
+}
+
+// Читает массив из values.size() чисел
+template <typename T, size_t N>
+void ParseNumbers(Parser& parser, std::array<T, N>& values, std::string_view object) {
+    size_t count = 0;
+    ParseArray(parser, [&] {
+        if (count == N) {
+            throw ParsingError(std::string(object) + ": too many values"s);
+        }
+        if constexpr (std::is_same_v<T, int>) {
+            values[count++] = parser.ReadInt();
+        } else {
+            values[count++] = parser.ReadDouble();
+        }
+    });
+    if (count < N) {
+        throw ParsingError(std::string(object) + ": not enough values"s);
     }
-    const std::string& name = stop_info.at("name"s).AsString();
-    const Stop* first_stop = catalogue.GetStop(name);
-    for (const auto& [stop, dist_node] : stop_info.at("road_distances"s).AsDict()) {
-        const Stop* second_stop = catalogue.GetStop(stop);
-        int distance = dist_node.AsDouble();
-        catalogue.SetDistance(first_stop, second_stop, distance);
+}
+
+/*
+ * Разбирает словарь по схеме: ключ переводится в Field, и read_field
+ * считывает значение в нужное поле. Ключи, которые read_field не распознал
+ * (вернул false), и неизвестные ключи пропускаются.
+ * Возвращает множество распознанных ключей
+ */
+template <typename FieldReader>
+FieldSet ParseDict(Parser& parser, FieldReader read_field) {
+    FieldSet seen = 0;
+    parser.StartDict();
+    while (const auto key = parser.NextKey()) {
+        const std::optional<Field> field = FindField(*key);
+        if (field && read_field(*field)) {
+            seen |= Bit(*field);
+        } else {
+            parser.SkipValue();
+        }
     }
+    return seen;
 }
 
-void ParseBus(const Node* bus_info_node, catalogue::TransportCatalogue& catalogue) {
-    if (bus_info_node->IsNull()) {
-        return;
+template <typename ItemReader>
+void ParseArray(Parser& parser, ItemReader read_item) {
+    parser.StartArray();
+    while (parser.NextItem()) {
+        read_item();
+    }
+}
+
+svg::Point ParsePoint(Parser& parser) {
+    parser.StartArray();
+    svg::Point point;
+    if (!parser.NextItem()) {
+        throw ParsingError("Point: x is expected"s);
+    }
+    point.x = parser.ReadDouble();
+    if (!parser.NextItem()) {
+        throw ParsingError("Point: y is expected"s);
     }
-    const Dict& bus_info = bus_info_node->AsDict();
-    const std::string& name = bus_info.at("name"s).AsString();
-    const bool is_round = bus_info.at("is_roundtrip"s).AsBool();
-    std::vector<const Stop*> stops;
-    for (const Node& stop_node : bus_info.at("stops"s).AsArray()) {
-        const std::string& stop = stop_node.AsString();
-        stops.push_back(catalogue.GetStop(stop));
+    point.y = parser.ReadDouble();
+    if (parser.NextItem()) {
+        throw ParsingError("Point: too many coordinates"s);
     }
-    catalogue.AddBus(Bus(name, stops, is_round));
+    return point;
 }
 
-void JsonReader::FillCatalogue(catalogue::TransportCatalogue& catalogue) const {
-    const Array& base = document_.GetRoot().AsDict().at("base_requests"s).AsArray();
-    std::vector<const Node*> stops_in;
-    std::vector<const Node*> buses_in;
-    for (const Node& elem_node : base) {
-        const Dict& elem = elem_node.AsDict();
-        if (elem.at("type"s) == "Stop"s) {
-            ParseStop(elem, catalogue);
-            stops_in.push_back(&elem_node);
+// Цвет задаётся строкой, массивом [r, g, b] или [r, g, b, opacity]
+svg::Color ParseColor(Parser& parser) {
+    if (parser.IsNextString()) {
+        return parser.ReadString();
+    }
+    std::array<int, 3> rgb{};
+    std::optional<double> opacity;
+    size_t count = 0;
+    ParseArray(parser, [&] {
+        if (count < rgb.size()) {
+            rgb[count] = parser.ReadInt();
+        } else if (count == rgb.size()) {
+            opacity = parser.ReadDouble();
+        } else {
+            throw ParsingError("Color: too many components"s);
+        }
+        ++count;
+    });
+    if (count < rgb.size()) {
+        throw ParsingError("Color: not enough components"s);
+    }
+    if (opacity) {
+        return svg::Rgba(rgb[0], rgb[1], rgb[2], *opacity);
+    }
+    return svg::Rgb(rgb[0], rgb[1], rgb[2]);
+}
+
+// Область карты: [min_lat, min_lng, max_lat, max_lng]
+renderer::GeoBox ParseGeoBox(Parser& parser) {
+    std::array<double, 4> values{};
+    ParseNumbers(parser, values, "bbox"sv);
+    const renderer::GeoBox box{{values[0], values[1]}, {values[2], values[3]}};
+    if (box.min.lat > box.max.lat || box.min.lng > box.max.lng) {
+        throw ParsingError("bbox: min corner is greater than max corner"s);
+    }
+    return box;
+}
+
+// Тайл карты: [zoom, x, y]
+renderer::Tile ParseTile(Parser& parser) {
+    std::array<int, 3> values{};
+    ParseNumbers(parser, values, "tile"sv);
+    const renderer::Tile tile{values[0], values[1], values[2]};
+    if (tile.zoom < 0 || tile.zoom > renderer::MAX_TILE_ZOOM) {
+        throw ParsingError("tile: zoom must be from 0 to "s
+                + std::to_string(renderer::MAX_TILE_ZOOM));
+    }
+    const long long parts = 1LL << tile.zoom;
+    if (tile.x < 0 || tile.x >= parts || tile.y < 0 || tile.y >= parts) {
+        throw ParsingError("tile: x and y must be from 0 to 2^zoom - 1"s);
+    }
+    return tile;
+}
+
+/*
+ * Остановки и маршруты в base_requests различаются полем "type",
+ * которое может идти после остальных полей, поэтому объект разбирается
+ * целиком в общую структуру и затем проверяется по своему типу
+ */
+struct BaseRequest {
+    std::string_view type;
+    json::Symbol name;
+    geo::Coordinates coordinates{};
+    std::vector<std::pair<json::Symbol, int>> road_distances;
+    std::vector<json::Symbol> stops;
+    bool is_roundtrip = false;
+};
+
+void ParseBaseRequest(Parser& parser,
+        std::vector<StopDescription>& stops,
+        std::vector<BusDescription>& buses) {
+    BaseRequest request;
+    const FieldSet seen = ParseDict(parser, [&](Field field) {
+        switch (field) {
+            case Field::TYPE:
+                request.type = parser.ReadSymbol().text;
+                return true;
+            case Field::NAME:
+                request.name = parser.ReadSymbol();
+                return true;
+            case Field::LATITUDE:
+                request.coordinates.lat = parser.ReadDouble();
+                return true;
+            case Field::LONGITUDE:
+                request.coordinates.lng = parser.ReadDouble();
+                return true;
+            case Field::ROAD_DISTANCES:
+                parser.StartDict();
+                while (const auto stop = parser.NextSymbolKey()) {
+                    request.road_distances.emplace_back(*stop,
+                            static_cast<int>(parser.ReadDouble()));
+                }
+                return true;
+            case Field::STOPS:
+                ParseArray(parser, [&] {
+                    request.stops.push_back(parser.ReadSymbol());
+                });
+                return true;
+            case Field::IS_ROUNDTRIP:
+                request.is_roundtrip = parser.ReadBool();
+                return true;
+            default:
+                return false;
         }
-        if (elem.at("type"s) == "Bus"s) {
-            buses_in.push_back(&elem_node);
+    });
+
+    CheckRequired(seen, Bits(Field::TYPE, Field::NAME), "base_requests"sv);
+    if (request.type == "Stop"sv) {
+        CheckRequired(seen, Bits(Field::LATITUDE, Field::LONGITUDE), "Stop"sv);
+        stops.push_back(StopDescription{request.name, request.coordinates,
+                std::move(request.road_distances)});
+    } else if (request.type == "Bus"sv) {
+        CheckRequired(seen, Bits(Field::STOPS, Field::IS_ROUNDTRIP), "Bus"sv);
+        buses.push_back(BusDescription{request.name, std::move(request.stops),
+                request.is_roundtrip});
+    }
+}
+
+RenderSettings ParseRenderSettings(Parser& parser) {
+    RenderSettings settings;
+    const FieldSet seen = ParseDict(parser, [&](Field field) {
+        switch (field) {
+            case Field::WIDTH:
+                settings.width = parser.ReadDouble();
+                return true;
+            case Field::HEIGHT:
+                settings.height = parser.ReadDouble();
+                return true;
+            case Field::PADDING:
+                settings.padding = parser.ReadDouble();
+                return true;
+            case Field::LINE_WIDTH:
+                settings.line_width = parser.ReadDouble();
+                return true;
+            case Field::STOP_RADIUS:
+                settings.stop_radius = parser.ReadDouble();
+                return true;
+            case Field::BUS_LABEL_FONT_SIZE:
+                settings.bus_label_font_size = parser.ReadInt();
+                return true;
+            case Field::BUS_LABEL_OFFSET:
+                settings.bus_label_offset = ParsePoint(parser);
+                return true;
+            case Field::STOP_LABEL_FONT_SIZE:
+                settings.stop_label_font_size = parser.ReadInt();
+                return true;
+            case Field::STOP_LABEL_OFFSET:
+                settings.stop_label_offset = ParsePoint(parser);
+                return true;
+            case Field::UNDERLAYER_COLOR:
+                settings.underlayer_color = ParseColor(parser);
+                return true;
+            case Field::UNDERLAYER_WIDTH:
+                settings.underlayer_width = parser.ReadDouble();
+                return true;
+            case Field::COLOR_PALETTE:
+                ParseArray(parser, [&] {
+                    settings.color_palette.push_back(ParseColor(parser));
+                });
+                if (settings.color_palette.empty()) {
+                    throw ParsingError("render_settings: color_palette must not be empty"s);
+                }
+                return true;
+            case Field::PRECISION:
+                settings.precision = parser.ReadInt();
+                if (*settings.precision < 0 || *settings.precision > svg::MAX_PRECISION) {
+                    throw ParsingError("render_settings: precision must be from 0 to "s
+                            + std::to_string(svg::MAX_PRECISION));
+                }
+                return true;
+            case Field::CSS_CLASSES:
+                settings.css_classes = parser.ReadBool();
+                return true;
+            case Field::SIMPLIFY_TOLERANCE:
+                settings.simplify_tolerance = parser.ReadDouble();
+                if (!(settings.simplify_tolerance >= 0.0)) {
+                    throw ParsingError(
+                            "render_settings: simplify_tolerance must be non-negative"s);
+                }
+                return true;
+            default:
+                return false;
         }
+    });
+    CheckRequired(seen, Bits(Field::WIDTH, Field::HEIGHT, Field::PADDING, Field::LINE_WIDTH,
+            Field::STOP_RADIUS, Field::BUS_LABEL_FONT_SIZE, Field::BUS_LABEL_OFFSET,
+            Field::STOP_LABEL_FONT_SIZE, Field::STOP_LABEL_OFFSET, Field::UNDERLAYER_COLOR,
+            Field::UNDERLAYER_WIDTH, Field::COLOR_PALETTE), "render_settings"sv);
+    return settings;
+}
+
+router::RoutingSettings ParseRoutingSettings(Parser& parser) {
+    router::RoutingSettings settings{};
+    const FieldSet seen = ParseDict(parser, [&](Field field) {
+        switch (field) {
+            case Field::BUS_WAIT_TIME:
+                settings.bus_wait_time = parser.ReadDouble();
+                return true;
+            case Field::BUS_VELOCITY:
+                settings.bus_velocity = parser.ReadDouble();
+                return true;
+            default:
+                return false;
+        }
+    });
+    CheckRequired(seen, Bits(Field::BUS_WAIT_TIME, Field::BUS_VELOCITY), "routing_settings"sv);
+    return settings;
+}
+
+std::optional<RequestType> ParseRequestType(std::string_view type) {
+    if (type == "Bus"sv) {
+        return RequestType::BUS;
     }
-    for (const Node* stop_dists : stops_in) {
-        SetDistance(stop_dists, catalogue);
+    if (type == "Stop"sv) {
+        return RequestType::STOP;
     }
-    for (const Node* bus_in : buses_in) {
-        ParseBus(bus_in, catalogue);
+    if (type == "Map"sv) {
+        return RequestType::MAP;
     }
+    if (type == "Route"sv) {
+        return RequestType::ROUTE;
+    }
+    return std::nullopt;
 }
 
-void SetUnderlayerColor(renderer::MapRenderer& renderer, const Node& color_node) {
-    if (color_node.IsString()) {
-        renderer.SetUnderlayerColor(color_node.AsString());
-    } else if (const Array& color_array = color_node.AsArray(); color_array.size() == 3) {
-        renderer.SetUnderlayerColor(color_array[0].AsInt(), color_array[1].AsInt(), color_array[2].AsInt());
-    } else {
-        renderer.SetUnderlayerColor(color_array[0].AsInt(), color_array[1].AsInt(), color_array[2].AsInt(), color_array[3].AsDouble());
+// Запросы неизвестного типа пропускаются. Если parsed_id задан, в него записывается
+// id запроса, как только он прочитан: по нему можно ответить на запрос с ошибкой
+std::optional<StatRequest> ParseStatRequest(Parser& parser,
+        std::optional<int>* parsed_id = nullptr) {
+    StatRequest request;
+    std::optional<RequestType> type;
+    const FieldSet seen = ParseDict(parser, [&](Field field) {
+        switch (field) {
+            case Field::ID:
+                request.id = parser.ReadInt();
+                if (parsed_id) {
+                    *parsed_id = request.id;
+                }
+                return true;
+            case Field::TYPE:
+                type = ParseRequestType(parser.ReadString());
+                return true;
+            case Field::NAME:
+                request.name = parser.ReadString();
+                return true;
+            case Field::FROM:
+                request.from = parser.ReadString();
+                return true;
+            case Field::TO:
+                request.to = parser.ReadString();
+                return true;
+            case Field::BBOX:
+                request.view = ParseGeoBox(parser);
+                return true;
+            case Field::TILE:
+                request.view = ParseTile(parser);
+                return true;
+            default:
+                return false;
+        }
+    });
+    CheckRequired(seen, Bits(Field::ID, Field::TYPE), "stat_requests"sv);
+    if (!type) {
+        return std::nullopt;
     }
+    request.type = *type;
+    switch (request.type) {
+        case RequestType::BUS:
+        case RequestType::STOP:
+            CheckRequired(seen, Bit(Field::NAME), "stat_requests"sv);
+            break;
+        case RequestType::ROUTE:
+            CheckRequired(seen, Bits(Field::FROM, Field::TO), "stat_requests"sv);
+            break;
+        case RequestType::MAP:
+            if ((seen & Bits(Field::BBOX, Field::TILE)) == Bits(Field::BBOX, Field::TILE)) {
+                throw ParsingError("stat_requests: Map takes either bbox or tile"s);
+            }
+            break;
+    }
+    return request;
 }
 
-void SetColorPallete(renderer::MapRenderer& renderer, const Node& color_node) {
-    if (color_node.IsString()) {
-        renderer.SetColorPalette(color_node.AsString());
-    } else if (const Array& color_array = color_node.AsArray(); color_array.size() == 3) {
-        renderer.SetColorPalette(color_array[0].AsInt(), color_array[1].AsInt(), color_array[2].AsInt());
-    } else {
-        renderer.SetColorPalette(color_array[0].AsInt(), color_array[1].AsInt(), color_array[2].AsInt(), color_array[3].AsDouble());
+bool ParseOutputCompact(Parser& parser) {
+    bool compact = false;
+    ParseDict(parser, [&](Field field) {
+        if (field != Field::COMPACT) {
+            return false;
+        }
+        compact = parser.ReadBool();
+        return true;
+    });
+    return compact;
+}
+
+} // namespace
+
+JsonReader::JsonReader(std::istream& in, std::ostream& out, bool stream_stat_requests)
+    : in_(in)
+    , out_(out)
+    , parser_(in) {
+    profiler::ScopedPhase phase("load"sv);
+    parser_.StartDict();
+    ReadRootFields(stream_stat_requests);
+}
+
+void JsonReader::ReadRootFields(bool stop_at_stat_requests) {
+    while (const auto key = parser_.NextKey()) {
+        const std::optional<Field> field = FindField(*key);
+        if (!field) {
+            parser_.SkipValue();
+            continue;
+        }
+        switch (*field) {
+            case Field::BASE_REQUESTS:
+                ParseArray(parser_, [&] {
+                    ParseBaseRequest(parser_, stops_, buses_);
+                });
+                break;
+            case Field::RENDER_SETTINGS:
+                render_settings_ = ParseRenderSettings(parser_);
+                break;
+            case Field::ROUTING_SETTINGS:
+                routing_settings_ = ParseRoutingSettings(parser_);
+                break;
+            case Field::STAT_REQUESTS:
+                // Запросы можно читать вместе с их выполнением, только если справочник
+                // и настройки уже известны
+                if (stop_at_stat_requests && !stops_.empty()
+                        && render_settings_ && routing_settings_) {
+                    stat_requests_deferred_ = true;
+                    return;
+                }
+                ParseArray(parser_, [&] {
+                    if (auto request = ParseStatRequest(parser_); request) {
+                        stat_requests_.push_back(std::move(*request));
+                    }
+                });
+                break;
+            case Field::OUTPUT_SETTINGS:
+                print_mode_ = ParseOutputCompact(parser_)
+                        ? json::PrintMode::COMPACT
+                        : json::PrintMode::PRETTY;
+                break;
+            default:
+                parser_.SkipValue();
+                break;
+        }
+    }
+}
+
+void JsonReader::FillCatalogue(catalogue::TransportCatalogue& catalogue) const {
+    profiler::ScopedPhase phase("fill_catalogue"sv);
+    // Остановки по id символа имени: ссылки на остановки разрешаются без поиска по имени
+    std::vector<const Stop*> stop_by_symbol(parser_.SymbolCount(), nullptr);
+    for (const StopDescription& stop : stops_) {
+        catalogue.AddStop(Stop(std::string(stop.name.text), stop.coordinates));
+        stop_by_symbol[stop.name.id] = catalogue.GetStop(stop.name.text);
+    }
+    for (const StopDescription& stop : stops_) {
+        const Stop* first_stop = stop_by_symbol[stop.name.id];
+        for (const auto& [other, distance] : stop.road_distances) {
+            catalogue.SetDistance(first_stop, stop_by_symbol[other.id], distance);
+        }
+    }
+    for (const BusDescription& bus : buses_) {
+        std::vector<const Stop*> stops;
+        stops.reserve(bus.stops.size());
+        for (const json::Symbol& stop : bus.stops) {
+            stops.push_back(stop_by_symbol[stop.id]);
+        }
+        catalogue.AddBus(Bus(std::string(bus.name.text), stops, bus.is_roundtrip));
     }
 }
 
 void JsonReader::FillRenderer(renderer::MapRenderer& renderer) const {
-    const Dict& settings = document_.GetRoot().AsDict().at("render_settings"s).AsDict();
-    renderer.SetWidth(settings.at("width"s).AsDouble());
-    renderer.SetHeight(settings.at("height"s).AsDouble());
-    renderer.SetPadding(settings.at("padding"s).AsDouble());
-    renderer.SetStopRadius(settings.at("stop_radius"s).AsDouble());
-    renderer.SetLineWidth(settings.at("line_width"s).AsDouble());
-    renderer.SetBusLabelFontSize(settings.at("bus_label_font_size"s).AsInt());
-    renderer.SetStopLabelFontSize(settings.at("stop_label_font_size"s).AsInt());
-    renderer.SetUnderlayerWidth(settings.at("underlayer_width"s).AsDouble());
+    profiler::ScopedPhase phase("fill_renderer"sv);
+    if (!render_settings_) {
+        throw ParsingError("render_settings is missing"s);
+    }
+    const RenderSettings& settings = *render_settings_;
+    renderer.SetWidth(settings.width);
+    renderer.SetHeight(settings.height);
+    renderer.SetPadding(settings.padding);
+    renderer.SetStopRadius(settings.stop_radius);
+    renderer.SetLineWidth(settings.line_width);
+    renderer.SetBusLabelFontSize(settings.bus_label_font_size);
+    renderer.SetStopLabelFontSize(settings.stop_label_font_size);
+    renderer.SetUnderlayerWidth(settings.underlayer_width);
+    renderer.SetUnderlayerColor(settings.underlayer_color);
+    renderer.SetBusLabelOffset(settings.bus_label_offset.x, settings.bus_label_offset.y);
+    renderer.SetStopLabelOffset(settings.stop_label_offset.x, settings.stop_label_offset.y);
+    for (const svg::Color& color : settings.color_palette) {
+        renderer.SetColorPalette(color);
+    }
+    if (settings.precision) {
+        renderer.SetPrecision(*settings.precision);
+    }
+    renderer.SetCssClasses(settings.css_classes);
+    renderer.SetSimplifyTolerance(settings.simplify_tolerance);
+}
+
+void JsonReader::FillRoutingSettings(router::RoutingSettings& routing_settings) const {
+    if (!routing_settings_) {
+        throw ParsingError("routing_settings is missing"s);
+    }
+    routing_settings.bus_wait_time = routing_settings_->bus_wait_time;
+    routing_settings.bus_velocity = routing_settings_->bus_velocity * 1000 / 60;
+}
+
+json::PrintMode JsonReader::GetPrintMode() const {
+    return print_mode_;
+}
 
-    SetUnderlayerColor(renderer, settings.at("underlayer_color"s));
+namespace {
 
-    const Array& bus_label_offset = settings.at("bus_label_offset"s).AsArray();
-    renderer.SetBusLabelOffset(bus_label_offset[0].AsDouble(), bus_label_offset[1].AsDouble());
+constexpr std::string_view id_key = "request_id"sv;
 
-    const Array& stop_label_offset = settings.at("stop_label_offset"s).AsArray();
-    renderer.SetStopLabelOffset(stop_label_offset[0].AsDouble(), stop_label_offset[1].AsDouble());
+// Положение значения request_id в сериализованном ответе
+struct IdPosition {
+    size_t begin = 0;
+    size_t end = 0;
+};
 
-    for (const Node& color_node : settings.at("color_palette"s).AsArray()) {
-        SetColorPallete(renderer, color_node);
+void WriteRequestId(Writer& writer, int id_value, IdPosition* id_position) {
+    writer.Key(id_key);
+    if (id_position) {
+        id_position->begin = writer.Position();
+    }
+    writer.Value(id_value);
+    if (id_position) {
+        id_position->end = writer.Position();
     }
 }
 
-void JsonReader::FillRoutingSettings(router::RoutingSettings& routing_settings) const {
-    const Dict& settings = document_.GetRoot().AsDict().at("routing_settings"s).AsDict();
-    routing_settings.bus_wait_time = settings.at("bus_wait_time"s).AsDouble();
-    routing_settings.bus_velocity = settings.at("bus_velocity"s).AsDouble() * 1000 / 60;
-}
-
-inline const std::string id_key{"request_id"};
-
-json::Dict BusRequests(const handler::RequestHandler& handler, const Dict& request) {
-    const int id_value = request.at("id"s).AsInt();
-    json::Builder result{};
-    result.StartDict()
-            .Key(id_key).Value(id_value);
-    const std::string& name = request.at("name"s).AsString();
-    if (const auto& bus_stat_opt = handler.GetBusStat(name); bus_stat_opt) {
-        result
-            .Key("curvature"s).Value(bus_stat_opt->curvature)
-            .Key("route_length"s).Value(bus_stat_opt->distance)
-            .Key("stop_count"s).Value(static_cast<int>(bus_stat_opt->number_stops))
-            .Key("unique_stop_count"s).Value(static_cast<int>(bus_stat_opt->uniq_stops));
-    } else {
-        result.Key("error_message"s).Value("not found"s);
+// Часть карты не хранится в ответе: она отрисовывается при выводе сразу в writer
+struct MapViewResponse {
+    const handler::RequestHandler* handler = nullptr;
+    renderer::GeoBox box;
+};
+
+// Результат выполнения запроса до сериализации. Отсутствующий маршрут,
+// остановка или автобус — monostate: ответ на них одинаков для всех типов
+struct Response {
+    int id = 0;
+    std::variant<std::monostate, domain::BusStat, const std::set<std::string_view>*,
+            const handler::RenderedMap*, MapViewResponse, domain::RouteInfo> result;
+};
+
+Response ExecuteRequest(const handler::RequestHandler& handler, const StatRequest& request) {
+    Response response;
+    response.id = request.id;
+    switch (request.type) {
+        case RequestType::BUS:
+            if (auto bus_stat = handler.GetBusStat(request.name); bus_stat) {
+                response.result = *bus_stat;
+            }
+            break;
+        case RequestType::STOP:
+            if (const auto* buses = handler.GetBusesByStop(request.name); buses) {
+                response.result = buses;
+            }
+            break;
+        case RequestType::MAP:
+            if (request.view) {
+                response.result = MapViewResponse{&handler, handler.GetMapViewBox(*request.view)};
+            } else {
+                response.result = &handler.RenderMap();
+            }
+            break;
+        case RequestType::ROUTE:
+            if (auto route = handler.GetRoute(request.from, request.to); route) {
+                response.result = std::move(*route);
+            }
+            break;
     }
-    result.EndDict();
-    return result.Build().AsDict();
+    return response;
 }
 
-json::Dict StopRequests(const handler::RequestHandler& handler, const Dict& request) {
-    const int id_value = request.at("id"s).AsInt();
-    json::Builder result{};
-    result.StartDict()
-            .Key(id_key).Value(id_value);
-    if (const auto& buses_names =
-            handler.GetBusesByStop(request.at("name"s).AsString()); buses_names) {
-        result.Key("buses"s).StartArray();
-        for (std::string_view bus_name : *buses_names) {
-            result.Value(std::string(bus_name));
+// Ключи ответов выводятся в лексикографическом порядке, как их упорядочивает json::Dict.
+// Если id_position задан, в него записывается положение request_id в выводе writer,
+// если svg_size — размер SVG карты в ответе
+void WriteResponse(const Response& response, Writer& writer, IdPosition* id_position = nullptr,
+        size_t* svg_size = nullptr) {
+    const int id_value = response.id;
+    writer.StartDict();
+    if (const auto* bus_stat = std::get_if<domain::BusStat>(&response.result)) {
+        writer.Key("curvature"sv).Value(bus_stat->curvature);
+        WriteRequestId(writer, id_value, id_position);
+        writer
+            .Key("route_length"sv).Value(bus_stat->distance)
+            .Key("stop_count"sv).Value(static_cast<int>(bus_stat->number_stops))
+            .Key("unique_stop_count"sv).Value(static_cast<int>(bus_stat->uniq_stops));
+    } else if (const auto* buses = std::get_if<const std::set<std::string_view>*>(&response.result)) {
+        writer.Key("buses"sv).StartArray();
+        for (std::string_view bus_name : **buses) {
+            writer.Value(bus_name);
         }
-        result.EndArray();
-    } else {
-        result.Key("error_message"s).Value("not found"s);
-    }
-    result.EndDict();
-    return result.Build().AsDict();
-}
-
-json::Dict MapRequests(const handler::RequestHandler& handler, const Dict& request) {
-    const int id_value = request.at("id"s).AsInt();
-    json::Builder result{};
-    result.StartDict()
-            .Key(id_key).Value(id_value)
-            .Key("map"s).Value(handler.RenderMap())
-            .EndDict();
-    return result.Build().AsDict();
-}
-
-json::Dict RouteRequests(const handler::RequestHandler& handler, const Dict& request) {
-    const int id_value = request.at("id"s).AsInt();
-    json::Builder result{};
-    result.StartDict()
-            .Key(id_key).Value(id_value);
-    const auto& items_opt = handler.GetRoute(
-            request.at("from"s).AsString(), request.at("to"s).AsString());
-    if (items_opt) {
-        result
-            .Key("total_time"s).Value(items_opt->total_time)
-            .Key("items"s).StartArray();
-        for (const auto& item : items_opt->items) {
+        writer.EndArray();
+        WriteRequestId(writer, id_value, id_position);
+    } else if (const auto* map = std::get_if<const handler::RenderedMap*>(&response.result)) {
+        // Экранированная строка карты тоже берётся из кеша
+        writer.Key("map"sv).RawValue((*map)->json);
+        WriteRequestId(writer, id_value, id_position);
+        if (svg_size) {
+            *svg_size = (*map)->svg_size;
+        }
+    } else if (const auto* map_view = std::get_if<MapViewResponse>(&response.result)) {
+        writer.Key("map"sv);
+        const size_t view_svg_size = map_view->handler->RenderMapView(map_view->box, writer);
+        WriteRequestId(writer, id_value, id_position);
+        if (svg_size) {
+            *svg_size = view_svg_size;
+        }
+    } else if (const auto* route = std::get_if<domain::RouteInfo>(&response.result)) {
+        writer.Key("items"sv).StartArray();
+        for (const auto& item : route->items) {
             if (item.type == domain::RouteItem::Type::WAIT) {
-                result.StartDict()
-                    .Key("type"s).Value("Wait"s)
-                    .Key("stop_name"s).Value(item.name)
-                    .Key("time"s).Value(item.time)
+                writer.StartDict()
+                    .Key("stop_name"sv).Value(item.name)
+                    .Key("time"sv).Value(item.time)
+                    .Key("type"sv).Value("Wait"sv)
                     .EndDict();
             } else if (item.type == domain::RouteItem::Type::BUS) {
-                result.StartDict()
-                    .Key("type"s).Value("Bus"s)
-                    .Key("bus"s).Value(item.name)
-                    .Key("time"s).Value(item.time)
-                    .Key("span_count"s).Value(*item.span_count)
+                writer.StartDict()
+                    .Key("bus"sv).Value(item.name)
+                    .Key("span_count"sv).Value(*item.span_count)
+                    .Key("time"sv).Value(item.time)
+                    .Key("type"sv).Value("Bus"sv)
                     .EndDict();
             }
         }
-        result.EndArray();
+        writer.EndArray();
+        WriteRequestId(writer, id_value, id_position);
+        writer.Key("total_time"sv).Value(route->total_time);
     } else {
-        result.Key("error_message"s).Value("not found"s);
-    }
-    result.EndDict();
-    return result.Build().AsDict();
-}
-
-void JsonReader::ProcessRequests(const handler::RequestHandler& handler) {
-    json::Builder result{};
-    result.StartArray();
-    const json::Array& stat = document_.GetRoot().AsDict().at("stat_requests"s).AsArray();
-    for (const json::Node& elem_node : stat) {
-        const json::Dict& request = elem_node.AsDict();
-        if (request.at("type"s) == "Bus"s) {
-            result.Value(BusRequests(handler, request));
-        } else if (request.at("type"s) == "Stop"s) {
-            result.Value(StopRequests(handler, request));
-        } else if (request.at("type"s) == "Map"s) {
-            result.Value(MapRequests(handler, request));
-        } else if (request.at("type"s) == "Route"s) {
-            result.Value(RouteRequests(handler, request));
-        }
-    }
-    result.EndArray();
-    Print(Document{result.Build()}, out_);
+        writer.Key("error_message"sv).Value("not found"sv);
+        WriteRequestId(writer, id_value, id_position);
+    }
+    writer.EndDict();
+}
+
+void ProcessRequest(const handler::RequestHandler& handler, const StatRequest& request,
+        Writer& writer, IdPosition* id_position = nullptr) {
+    WriteResponse(ExecuteRequest(handler, request), writer, id_position);
+}
+
+// Ответ на запрос, который не удалось разобрать или выполнить
+void WriteError(Writer& writer, std::string_view message, std::optional<int> id) {
+    writer.StartDict().Key("error_message"sv).Value(message);
+    if (id) {
+        writer.Key(id_key).Value(*id);
+    }
+    writer.EndDict();
+}
+
+// То, что обработчик учёл в метриках при выполнении запроса. Размер SVG карты
+// становится известен только при выводе ответа
+handler::RepeatedRequest DescribeRepeat(const StatRequest& request, const Response& response) {
+    handler::RepeatedRequest repeat;
+    switch (request.type) {
+        case RequestType::BUS:
+            repeat.kind = metrics::RequestKind::BUS;
+            break;
+        case RequestType::STOP:
+            repeat.kind = metrics::RequestKind::STOP;
+            break;
+        case RequestType::MAP:
+            repeat.kind = metrics::RequestKind::MAP;
+            break;
+        case RequestType::ROUTE:
+            repeat.kind = metrics::RequestKind::ROUTE;
+            break;
+    }
+    repeat.found = !std::holds_alternative<std::monostate>(response.result);
+    if (const auto* route = std::get_if<domain::RouteInfo>(&response.result)) {
+        repeat.route_edges = handler::CountRouteEdges(*route);
+    }
+    return repeat;
+}
+
+// Ошибка одного запроса не должна обрывать поток ответов: запрос выполняется
+// до начала вывода, и вместо ответа на него выводится сообщение об ошибке
+void ProcessRequestOrError(const handler::RequestHandler& handler, const StatRequest& request,
+        Writer& writer) {
+    Response response;
+    try {
+        response = ExecuteRequest(handler, request);
+    } catch (const std::exception& error) {
+        WriteError(writer, error.what(), request.id);
+        return;
+    }
+    WriteResponse(response, writer);
+}
+
+/*
+ * Ответы на повторяющиеся запросы пакета. Запросы сравниваются без учёта id.
+ * Перед обработкой пакет просматривается целиком: ответ запоминается только
+ * для запросов, которые встречаются больше одного раза, и освобождается после
+ * последнего использования. Повтор выводится из сохранённого текста с подстановкой
+ * своего request_id. Запросы полной карты не запоминаются: обработчик хранит
+ * её готовый ответ сам. Write можно вызывать из нескольких потоков
+ */
+class ResponseMemo {
+public:
+    ResponseMemo(const std::vector<StatRequest>& requests, json::PrintMode mode)
+        : requests_(requests)
+        , mode_(mode)
+        , entry_by_request_(requests.size(), NO_ENTRY) {
+        std::unordered_map<std::string, size_t> first_by_key;
+        std::vector<size_t> first_request(requests.size());
+        std::vector<size_t> counts(requests.size(), 0);
+        size_t memoized_count = 0;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (!IsMemoized(requests[i])) {
+                first_request[i] = i;
+                ++counts[i];
+                continue;
+            }
+            ++memoized_count;
+            const auto [it, inserted] = first_by_key.emplace(MakeKey(requests[i]), i);
+            first_request[i] = it->second;
+            ++counts[it->second];
+        }
+        std::vector<size_t> entry_by_first(requests.size(), NO_ENTRY);
+        size_t entry_count = 0;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const size_t first = first_request[i];
+            if (counts[first] < 2) {
+                continue;
+            }
+            if (entry_by_first[first] == NO_ENTRY) {
+                entry_by_first[first] = entry_count++;
+            }
+            entry_by_request_[i] = entry_by_first[first];
+        }
+        entries_ = std::vector<Entry>(entry_count);
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (first_request[i] == i && counts[i] > 1) {
+                entries_[entry_by_first[i]].uses = counts[i];
+                entries_[entry_by_first[i]].remaining = counts[i];
+            }
+        }
+        stats_.request_count = requests.size();
+        stats_.duplicate_count = memoized_count - first_by_key.size();
+    }
+
+    // Встречается ли запрос в пакете больше одного раза
+    bool IsRepeated(size_t index) const {
+        return entry_by_request_[index] != NO_ENTRY;
+    }
+
+    // Повтор, выданный из сохранённого ответа, учитывается в метриках обработчика
+    // как обычный запрос; его задержка — время ожидания ответа и его вывода
+    void Write(const handler::RequestHandler& handler, size_t index, Writer& writer) {
+        const size_t entry_index = entry_by_request_[index];
+        if (entry_index == NO_ENTRY) {
+            ProcessRequest(handler, requests_[index], writer);
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        Entry& entry = entries_[entry_index];
+        bool computed = false;
+        std::call_once(entry.computed, [&] {
+            Compute(handler, requests_[index], entry);
+            computed = true;
+        });
+
+        char id_chars[16];
+        const auto result = std::to_chars(std::begin(id_chars), std::end(id_chars),
+                requests_[index].id);
+        const std::string_view body = entry.body;
+        writer.RawValue(body.substr(0, entry.id_position.begin))
+                .AppendRaw(std::string_view(id_chars, result.ptr - id_chars))
+                .AppendRaw(body.substr(entry.id_position.end));
+
+        if (--entry.remaining == 0) {
+            std::string().swap(entry.body);
+        }
+        if (!computed) {
+            handler.RecordRepeat(entry.repeat, std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    BatchStats GetStats() const {
+        BatchStats stats = stats_;
+        for (const Entry& entry : entries_) {
+            stats.saved_seconds += entry.compute_seconds * (entry.uses - 1);
+        }
+        return stats;
+    }
+
+private:
+    static constexpr size_t NO_ENTRY = std::numeric_limits<size_t>::max();
+    // Большинство ответов короткие; крупные строки Writer пишет мимо буфера
+    static constexpr size_t CAPTURE_BUFFER_SIZE = 4 * 1024;
+
+    struct Entry {
+        std::once_flag computed;
+        std::string body;
+        IdPosition id_position;
+        handler::RepeatedRequest repeat;
+        double compute_seconds = 0.0;
+        size_t uses = 0;
+        std::atomic<size_t> remaining = 0;
+    };
+
+    const std::vector<StatRequest>& requests_;
+    json::PrintMode mode_;
+    std::vector<size_t> entry_by_request_;
+    std::vector<Entry> entries_;
+    BatchStats stats_;
+
+    // Копия многомегабайтной полной карты дублировала бы её кеш в обработчике
+    static bool IsMemoized(const StatRequest& request) {
+        return request.type != RequestType::MAP || request.view.has_value();
+    }
+
+    static std::string MakeKey(const StatRequest& request) {
+        std::string key;
+        key.reserve(request.name.size() + request.from.size() + request.to.size() + 3);
+        key.push_back(static_cast<char>(request.type));
+        key.append(request.name).push_back('\0');
+        key.append(request.from).push_back('\0');
+        key.append(request.to);
+        if (request.view) {
+            // Координаты сравниваются побайтно
+            key.push_back('\0');
+            key.push_back(static_cast<char>(request.view->index()));
+            std::visit([&key](const auto& view) {
+                key.append(reinterpret_cast<const char*>(&view), sizeof(view));
+            }, *request.view);
+        }
+        return key;
+    }
+
+    // Ответ сериализуется как элемент массива ответов, чтобы совпали отступы
+    void Compute(const handler::RequestHandler& handler, const StatRequest& request,
+            Entry& entry) const {
+        const auto start = std::chrono::steady_clock::now();
+        std::ostringstream stream;
+        {
+            Writer writer(stream, mode_, CAPTURE_BUFFER_SIZE);
+            writer.ResumeArray(false);
+            const Response response = ExecuteRequest(handler, request);
+            entry.repeat = DescribeRepeat(request, response);
+            size_t svg_size = 0;
+            WriteResponse(response, writer, &entry.id_position, &svg_size);
+            entry.repeat.svg_bytes = svg_size;
+        }
+        entry.body = stream.str();
+        // Ответ — всегда словарь; начальный отступ элемента отбрасывается
+        const size_t body_begin = entry.body.find('{');
+        entry.body.erase(0, body_begin);
+        entry.id_position.begin -= body_begin;
+        entry.id_position.end -= body_begin;
+        entry.compute_seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Выполняет запросы requests[indices[k]] пакетными методами RequestHandler;
+// результат для indices[k] возвращается в k-м элементе
+std::vector<Response> ExecuteRequests(const handler::RequestHandler& handler,
+        const std::vector<StatRequest>& requests, const std::vector<size_t>& indices) {
+    std::vector<Response> responses(indices.size());
+    std::vector<std::string_view> bus_names;
+    std::vector<size_t> bus_slots;
+    std::vector<std::string_view> stop_names;
+    std::vector<size_t> stop_slots;
+    std::vector<router::RouteQuery> route_queries;
+    std::vector<size_t> route_slots;
+    for (size_t k = 0; k < indices.size(); ++k) {
+        const StatRequest& request = requests[indices[k]];
+        responses[k].id = request.id;
+        switch (request.type) {
+            case RequestType::BUS:
+                bus_names.push_back(request.name);
+                bus_slots.push_back(k);
+                break;
+            case RequestType::STOP:
+                stop_names.push_back(request.name);
+                stop_slots.push_back(k);
+                break;
+            case RequestType::MAP:
+                if (request.view) {
+                    responses[k].result = MapViewResponse{&handler, handler.GetMapViewBox(*request.view)};
+                } else {
+                    responses[k].result = &handler.RenderMap();
+                }
+                break;
+            case RequestType::ROUTE:
+                route_queries.push_back({request.from, request.to});
+                route_slots.push_back(k);
+                break;
+        }
+    }
+
+    std::vector<std::optional<domain::BusStat>> bus_stats(bus_names.size());
+    handler.GetBusStats(ranges::AsSpan(std::as_const(bus_names)), ranges::AsSpan(bus_stats));
+    for (size_t j = 0; j < bus_stats.size(); ++j) {
+        if (bus_stats[j]) {
+            responses[bus_slots[j]].result = *bus_stats[j];
+        }
+    }
+
+    std::vector<const std::set<std::string_view>*> stop_buses(stop_names.size());
+    handler.GetBusesByStops(ranges::AsSpan(std::as_const(stop_names)), ranges::AsSpan(stop_buses));
+    for (size_t j = 0; j < stop_buses.size(); ++j) {
+        if (stop_buses[j]) {
+            responses[stop_slots[j]].result = stop_buses[j];
+        }
+    }
+
+    std::vector<std::optional<domain::RouteInfo>> routes(route_queries.size());
+    handler.GetRoutes(ranges::AsSpan(std::as_const(route_queries)), ranges::AsSpan(routes));
+    for (size_t j = 0; j < routes.size(); ++j) {
+        if (routes[j]) {
+            responses[route_slots[j]].result = std::move(*routes[j]);
+        }
+    }
+    return responses;
+}
+
+// Отвечает на запросы [begin, end): неповторяющиеся выполняются одним пакетом,
+// повторы берутся из memo
+void WriteRequestBlock(const handler::RequestHandler& handler,
+        const std::vector<StatRequest>& requests, ResponseMemo& memo,
+        size_t begin, size_t end, Writer& writer) {
+    std::vector<size_t> indices;
+    indices.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        if (!memo.IsRepeated(i)) {
+            indices.push_back(i);
+        }
+    }
+    const std::vector<Response> responses = ExecuteRequests(handler, requests, indices);
+    auto response = responses.begin();
+    for (size_t i = begin; i < end; ++i) {
+        if (memo.IsRepeated(i)) {
+            memo.Write(handler, i, writer);
+        } else {
+            WriteResponse(*response++, writer);
+        }
+    }
+}
+
+/*
+ * Отвечает на запросы в нескольких потоках. Запросы делятся на блоки подряд идущих;
+ * поток берёт очередной блок и сериализует его в свой буфер как продолжение массива
+ * ответов. Вызывающий поток выводит готовые блоки в исходном порядке, поэтому вывод
+ * совпадает с последовательным. Число готовых, но не выведенных блоков ограничено,
+ * чтобы ответы не накапливались в памяти целиком
+ */
+void ProcessRequestsParallel(const handler::RequestHandler& handler,
+        const std::vector<StatRequest>& requests, ResponseMemo& memo, json::PrintMode mode,
+        size_t thread_count, std::ostream& out) {
+    struct Block {
+        std::string output;
+        bool ready = false;
+    };
+
+    const size_t block_size = std::clamp<size_t>(requests.size() / (thread_count * 16), 1, 256);
+    const size_t block_count = (requests.size() + block_size - 1) / block_size;
+    const size_t window = thread_count * 4;
+    std::vector<Block> blocks(block_count);
+
+    std::mutex mutex;
+    std::condition_variable block_ready;
+    std::condition_variable block_written;
+    size_t next_block = 0;
+    size_t written = 0;
+    std::exception_ptr error;
+
+    auto work = [&] {
+        std::ostringstream stream;
+        Writer writer(stream, mode);
+        while (true) {
+            size_t index = 0;
+            {
+                std::unique_lock lock(mutex);
+                block_written.wait(lock, [&] {
+                    return next_block == block_count || next_block < written + window;
+                });
+                if (next_block == block_count) {
+                    return;
+                }
+                index = next_block++;
+            }
+            try {
+                writer.ResumeArray(index != 0);
+                const size_t end = std::min(requests.size(), (index + 1) * block_size);
+                WriteRequestBlock(handler, requests, memo, index * block_size, end, writer);
+                writer.Flush();
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next_block = block_count;
+                block_ready.notify_all();
+                block_written.notify_all();
+                return;
+            }
+            std::string output = stream.str();
+            stream.str({});
+            {
+                std::lock_guard lock(mutex);
+                blocks[index].output = std::move(output);
+                blocks[index].ready = true;
+            }
+            block_ready.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back(work);
+    }
+    for (size_t index = 0; index < block_count; ++index) {
+        std::string output;
+        {
+            std::unique_lock lock(mutex);
+            block_ready.wait(lock, [&] { return blocks[index].ready || error; });
+            if (error) {
+                break;
+            }
+            output = std::move(blocks[index].output);
+            written = index + 1;
+        }
+        block_written.notify_all();
+        out.write(output.data(), output.size());
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace
+
+BatchStats JsonReader::ProcessRequests(const handler::RequestHandler& handler,
+        json::PrintMode mode, size_t thread_count) {
+    if (stat_requests_deferred_) {
+        return ProcessRequestsPipelined(handler, mode);
+    }
+    ResponseMemo memo(stat_requests_, mode);
+    Writer writer(out_, mode);
+    writer.StartArray();
+    if (thread_count <= 1 || stat_requests_.size() <= 1) {
+        // Блоками, чтобы выполненные, но не выведенные ответы не копились в памяти
+        constexpr size_t BLOCK_SIZE = 256;
+        for (size_t begin = 0; begin < stat_requests_.size(); begin += BLOCK_SIZE) {
+            const size_t end = std::min(stat_requests_.size(), begin + BLOCK_SIZE);
+            WriteRequestBlock(handler, stat_requests_, memo, begin, end, writer);
+        }
+    } else {
+        writer.Flush();
+        ProcessRequestsParallel(handler, stat_requests_, memo, mode, thread_count, out_);
+    }
+    writer.EndArray();
+    return memo.GetStats();
+}
+
+BatchStats JsonReader::ProcessRequestsPipelined(const handler::RequestHandler& handler,
+        json::PrintMode mode) {
+    // Глубина очередей ограничивает память: ответ на запрос Map может занимать мегабайты
+    constexpr size_t REQUEST_QUEUE_CAPACITY = 1024;
+    constexpr size_t RESPONSE_QUEUE_CAPACITY = 64;
+    concurrent::SpscQueue<StatRequest> requests(REQUEST_QUEUE_CAPACITY);
+    concurrent::SpscQueue<Response> responses(RESPONSE_QUEUE_CAPACITY);
+    std::exception_ptr execute_error;
+    std::exception_ptr write_error;
+
+    std::thread executor([&] {
+        try {
+            StatRequest request;
+            while (requests.Pop(request)) {
+                if (!responses.Push(ExecuteRequest(handler, request))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            execute_error = std::current_exception();
+        }
+        // Останавливает и разбор, если выполнение прервалось
+        requests.Close();
+        responses.Close();
+    });
+    std::thread serializer([&] {
+        try {
+            Writer writer(out_, mode);
+            writer.StartArray();
+            Response response;
+            while (responses.Pop(response)) {
+                WriteResponse(response, writer);
+            }
+            writer.EndArray();
+        } catch (...) {
+            write_error = std::current_exception();
+            responses.Close();
+        }
+    });
+
+    BatchStats stats;
+    std::exception_ptr parse_error;
+    try {
+        // Закрытая очередь означает, что выполнение или вывод прервались с ошибкой:
+        // остаток запросов не разбирается
+        parser_.StartArray();
+        while (parser_.NextItem()) {
+            if (auto request = ParseStatRequest(parser_); request) {
+                ++stats.request_count;
+                if (!requests.Push(std::move(*request))) {
+                    break;
+                }
+            }
+        }
+    } catch (...) {
+        parse_error = std::current_exception();
+    }
+    requests.Close();
+    executor.join();
+    serializer.join();
+    stat_requests_deferred_ = false;
+
+    for (const std::exception_ptr& error : {parse_error, execute_error, write_error}) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    // Остаток документа после "stat_requests"
+    ReadRootFields(false);
+    return stats;
+}
+
+void JsonReader::ProcessRequestLines(const handler::RequestHandler& handler) {
+    Writer writer(out_, json::PrintMode::COMPACT);
+    // Каждый ответ — отдельное значение верхнего уровня в своей строке
+    auto write_line = [this, &writer] {
+        writer.Flush();
+        out_.put('\n');
+        out_.flush();
+    };
+
+    for (const StatRequest& request : stat_requests_) {
+        ProcessRequestOrError(handler, request, writer);
+        write_line();
+    }
+
+    std::string line;
+    while (std::getline(in_, line)) {
+        if (ProcessRequestLine(handler, line, writer)) {
+            write_line();
+        }
+    }
+}
+
+bool ProcessRequestLine(const handler::RequestHandler& handler, std::string_view line,
+        json::Writer& writer) {
+    if (line.find_first_not_of(" \t\r"sv) == std::string_view::npos) {
+        return false;
+    }
+    std::optional<StatRequest> request;
+    std::optional<int> id;
+    try {
+        std::istringstream line_input{std::string(line)};
+        Parser parser(line_input);
+        request = ParseStatRequest(parser, &id);
+    } catch (const ParsingError& error) {
+        WriteError(writer, error.what(), id);
+        return true;
+    }
+    if (!request) {
+        return false;
+    }
+    ProcessRequestOrError(handler, *request, writer);
+    return true;
 }
 
 } //end namespace catalogue::input
@@ -1,16 +1,91 @@
 #pragma once
 
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 #include "transport_catalogue.h"
 #include "map_renderer.h"
+#include "map_index.h"
 #include "request_handler.h"
 #include "transport_router.h"
 #include "json.h"
+#include "json_writer.h"
+#include "geo.h"
+#include "svg.h"
 
 namespace json_reader {
 
+// Имена в описаниях — символы парсера JsonReader: имя остановки хранится один раз,
+// сколько бы объектов на неё ни ссылалось
+struct StopDescription {
+    json::Symbol name;
+    geo::Coordinates coordinates;
+    std::vector<std::pair<json::Symbol, int>> road_distances;
+};
+
+struct BusDescription {
+    json::Symbol name;
+    std::vector<json::Symbol> stops;
+    bool is_roundtrip = false;
+};
+
+struct RenderSettings {
+    double width = 0.0;
+    double height = 0.0;
+    double padding = 0.0;
+    double line_width = 0.0;
+    double stop_radius = 0.0;
+    int bus_label_font_size = 0;
+    svg::Point bus_label_offset;
+    int stop_label_font_size = 0;
+    svg::Point stop_label_offset;
+    svg::Color underlayer_color;
+    double underlayer_width = 0.0;
+    std::vector<svg::Color> color_palette;
+    std::optional<int> precision;
+    bool css_classes = false;
+    double simplify_tolerance = 0.0;
+};
+
+enum class RequestType {
+    BUS,
+    STOP,
+    MAP,
+    ROUTE,
+};
+
+struct StatRequest {
+    int id = 0;
+    RequestType type = RequestType::BUS;
+    std::string name;   // Bus, Stop
+    std::string from;   // Route
+    std::string to;     // Route
+    std::optional<renderer::MapView> view;  // Map: часть карты вместо полной
+};
+
+// Статистика обработки пакета stat_requests
+struct BatchStats {
+    size_t request_count = 0;
+    // Запросы, совпавшие с более ранним без учёта id
+    size_t duplicate_count = 0;
+    // Оценка: сколько заняло бы повторное вычисление ответов на повторы
+    double saved_seconds = 0.0;
+};
+
+/*
+ * Читает входной документ по известной схеме: остановки, маршруты,
+ * настройки и запросы разбираются сразу в типизированные структуры,
+ * без построения json::Dict. Обязательные поля проверяются при разборе
+ */
 class JsonReader {
 public:
-    JsonReader(std::istream& in, std::ostream& out);
+    // При stream_stat_requests разбор останавливается перед "stat_requests",
+    // если справочник и настройки уже прочитаны; запросы тогда читаются
+    // в ProcessRequests одновременно с выполнением
+    JsonReader(std::istream& in, std::ostream& out, bool stream_stat_requests = false);
 
     void FillCatalogue(catalogue::TransportCatalogue& catalogue) const;
 
@@ -18,11 +93,44 @@ public:
 
     void FillRoutingSettings(router::RoutingSettings& routing_settings) const;
 
-    void ProcessRequests(const handler::RequestHandler& handler);
+    // Режим вывода ответов из "output_settings"; по умолчанию PRETTY
+    json::PrintMode GetPrintMode() const;
+
+    // При thread_count > 1 запросы обрабатываются параллельно; вывод совпадает
+    // с последовательным. Ответ на повторяющийся запрос вычисляется один раз
+    BatchStats ProcessRequests(const handler::RequestHandler& handler,
+            json::PrintMode mode = json::PrintMode::PRETTY, size_t thread_count = 1);
+
+    // Режим NDJSON: после исходного документа запросы читаются из того же
+    // потока по одному JSON-объекту на строку. Ответ на каждый запрос выводится
+    // компактно отдельной строкой и сбрасывается в поток сразу после вычисления
+    void ProcessRequestLines(const handler::RequestHandler& handler);
 
 private:
-    const json::Document document_;
+    std::vector<StopDescription> stops_;
+    std::vector<BusDescription> buses_;
+    std::optional<RenderSettings> render_settings_;
+    std::optional<router::RoutingSettings> routing_settings_;
+    std::vector<StatRequest> stat_requests_;
+    json::PrintMode print_mode_ = json::PrintMode::PRETTY;
+    std::istream& in_;
     std::ostream& out_;
+    json::Parser parser_;
+    bool stat_requests_deferred_ = false;
+
+    void ReadRootFields(bool stop_at_stat_requests);
+
+    // Конвейер: разбор запросов в вызывающем потоке, выполнение и вывод ответов —
+    // в отдельных потоках; стадии связаны ограниченными очередями
+    BatchStats ProcessRequestsPipelined(const handler::RequestHandler& handler,
+            json::PrintMode mode);
 };
 
+// Отвечает на запрос, записанный одной строкой NDJSON. Пустые строки и запросы
+// неизвестного типа пропускаются: возвращается false и в writer ничего не пишется.
+// Ошибка разбора или выполнения выводится как {"error_message": ..., "request_id": ...};
+// request_id нет, если ошибка случилась до того, как он прочитан
+bool ProcessRequestLine(const handler::RequestHandler& handler, std::string_view line,
+        json::Writer& writer);
+
 } //end namespace catalogue::input
@@ -0,0 +1,294 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <stdexcept>
+
+namespace json {
+using namespace std::literals;
+
+Writer::Writer(std::ostream& output, PrintMode mode, size_t buffer_size)
+    : output_(output)
+    , buffer_size_(buffer_size)
+    , mode_(mode) {
+    buffer_.reserve(buffer_size_);
+}
+
+Writer::~Writer() {
+    Flush();
+}
+
+Writer& Writer::Key(std::string_view key) {
+    if (scopes_.empty() || !scopes_.back().is_dict || scopes_.back().has_key) {
+        throw std::logic_error("Incorrect call .Key()"s);
+    }
+    Scope& scope = scopes_.back();
+    if (!scope.is_first) {
+        Write(',');
+        WriteNewLine();
+    }
+    scope.is_first = false;
+    scope.has_key = true;
+    WriteIndent();
+    WriteString(key);
+    Write(mode_ == PrintMode::COMPACT ? ":"sv : ": "sv);
+    return *this;
+}
+
+Writer& Writer::Value(std::nullptr_t) {
+    BeginValue();
+    Write("null"sv);
+    return *this;
+}
+
+Writer& Writer::Value(bool value) {
+    BeginValue();
+    Write(value ? "true"sv : "false"sv);
+    return *this;
+}
+
+Writer& Writer::Value(int value) {
+    BeginValue();
+    char chars[16];
+    const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+    Write(std::string_view(chars, result.ptr - chars));
+    return *this;
+}
+
+Writer& Writer::Value(std::int64_t value) {
+    BeginValue();
+    char chars[24];
+    const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+    Write(std::string_view(chars, result.ptr - chars));
+    return *this;
+}
+
+Writer& Writer::Value(double value) {
+    BeginValue();
+    // Формат совпадает с выводом double в std::ostream по умолчанию (%g, 6 знаков)
+    char chars[32];
+    const auto result = std::to_chars(std::begin(chars), std::end(chars), value,
+            std::chars_format::general, 6);
+    Write(std::string_view(chars, result.ptr - chars));
+    return *this;
+}
+
+Writer& Writer::Value(std::string_view value) {
+    BeginValue();
+    WriteString(value);
+    return *this;
+}
+
+Writer& Writer::Value(const char* value) {
+    return Value(std::string_view(value));
+}
+
+Writer& Writer::StartArray() {
+    BeginValue();
+    Write('[');
+    WriteNewLine();
+    scopes_.push_back(Scope{false});
+    return *this;
+}
+
+Writer& Writer::EndArray() {
+    if (scopes_.empty() || scopes_.back().is_dict) {
+        throw std::logic_error("Not Array. Can't call .EndArray()"s);
+    }
+    scopes_.pop_back();
+    WriteNewLine();
+    WriteIndent();
+    Write(']');
+    return *this;
+}
+
+Writer& Writer::StartDict() {
+    BeginValue();
+    Write('{');
+    WriteNewLine();
+    scopes_.push_back(Scope{true});
+    return *this;
+}
+
+Writer& Writer::EndDict() {
+    if (scopes_.empty() || !scopes_.back().is_dict || scopes_.back().has_key) {
+        throw std::logic_error("Not Dict. Can't call .EndDict()"s);
+    }
+    scopes_.pop_back();
+    WriteNewLine();
+    WriteIndent();
+    Write('}');
+    return *this;
+}
+
+Writer& Writer::ResumeArray(bool has_elements) {
+    scopes_.clear();
+    scopes_.push_back(Scope{false, !has_elements});
+    return *this;
+}
+
+Writer& Writer::RawValue(std::string_view json) {
+    BeginValue();
+    Write(json);
+    return *this;
+}
+
+Writer& Writer::AppendRaw(std::string_view json) {
+    Write(json);
+    return *this;
+}
+
+Writer& Writer::StartString() {
+    BeginValue();
+    Write('"');
+    return *this;
+}
+
+Writer& Writer::AppendString(std::string_view part) {
+    WriteEscaped(part);
+    return *this;
+}
+
+Writer& Writer::EndString() {
+    Write('"');
+    return *this;
+}
+
+size_t Writer::Position() const {
+    return flushed_size_ + buffer_.size();
+}
+
+void Writer::Flush() {
+    output_.write(buffer_.data(), buffer_.size());
+    flushed_size_ += buffer_.size();
+    buffer_.clear();
+}
+
+void Writer::BeginValue() {
+    if (scopes_.empty()) {
+        return;
+    }
+    Scope& scope = scopes_.back();
+    if (scope.is_dict) {
+        if (!scope.has_key) {
+            throw std::logic_error("Incorrect call .Value()"s);
+        }
+        scope.has_key = false;
+        return;
+    }
+    if (!scope.is_first) {
+        Write(',');
+        WriteNewLine();
+    }
+    scope.is_first = false;
+    WriteIndent();
+}
+
+void Writer::WriteIndent() {
+    if (mode_ == PrintMode::COMPACT) {
+        return;
+    }
+    const size_t indent = scopes_.size() * indent_step_;
+    if (buffer_.size() + indent > buffer_size_) {
+        Flush();
+    }
+    buffer_.append(indent, ' ');
+}
+
+void Writer::WriteNewLine() {
+    if (mode_ != PrintMode::COMPACT) {
+        Write('\n');
+    }
+}
+
+void Writer::WriteString(std::string_view value) {
+    Write('"');
+    WriteEscaped(value);
+    Write('"');
+}
+
+void Writer::WriteEscaped(std::string_view value) {
+    // Участки без спецсимволов копируются целиком
+    size_t run_begin = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        std::string_view escaped;
+        switch (value[i]) {
+            case '\r':
+                escaped = "\\r"sv;
+                break;
+            case '\n':
+                escaped = "\\n"sv;
+                break;
+            case '"':
+                escaped = "\\\""sv;
+                break;
+            case '\\':
+                escaped = "\\\\"sv;
+                break;
+            default:
+                continue;
+        }
+        Write(value.substr(run_begin, i - run_begin));
+        Write(escaped);
+        run_begin = i + 1;
+    }
+    Write(value.substr(run_begin));
+}
+
+void Writer::Write(std::string_view data) {
+    if (buffer_.size() + data.size() > buffer_size_) {
+        Flush();
+        if (data.size() >= buffer_size_) {
+            output_.write(data.data(), data.size());
+            flushed_size_ += data.size();
+            return;
+        }
+    }
+    buffer_.append(data);
+}
+
+void Writer::Write(char c) {
+    if (buffer_.size() == buffer_size_) {
+        Flush();
+    }
+    buffer_.push_back(c);
+}
+
+StringValueBuf::StringValueBuf(Writer& writer)
+    : writer_(writer) {
+}
+
+size_t StringValueBuf::Size() const {
+    return size_;
+}
+
+std::streamsize StringValueBuf::xsputn(const char* data, std::streamsize size) {
+    writer_.AppendString({data, static_cast<size_t>(size)});
+    size_ += size;
+    return size;
+}
+
+StringValueBuf::int_type StringValueBuf::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        const char ch = traits_type::to_char_type(c);
+        xsputn(&ch, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+StringAppendBuf::StringAppendBuf(std::string& output)
+    : output_(output) {
+}
+
+std::streamsize StringAppendBuf::xsputn(const char* data, std::streamsize size) {
+    output_.append(data, static_cast<size_t>(size));
+    return size;
+}
+
+StringAppendBuf::int_type StringAppendBuf::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        output_.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+} // namespace json
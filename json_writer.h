@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.h"
+
+namespace json {
+
+/*
+ * Потоковый вывод JSON без построения дерева узлов.
+ * Форматирует значения так же, как json::Print в выбранном режиме,
+ * накапливает их в буфере заданного размера и сбрасывает в поток крупными блоками.
+ * Ключи словаря выводятся в порядке вызова Key, поэтому для совпадения
+ * с json::Print их нужно передавать в лексикографическом порядке
+ */
+class Writer {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    explicit Writer(std::ostream& output, PrintMode mode = PrintMode::PRETTY,
+            size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer();
+
+    Writer& Key(std::string_view key);
+    Writer& Value(std::nullptr_t);
+    Writer& Value(bool value);
+    Writer& Value(int value);
+    Writer& Value(std::int64_t value);
+    Writer& Value(double value);
+    Writer& Value(std::string_view value);
+    Writer& Value(const char* value);
+    Writer& StartArray();
+    Writer& EndArray();
+    Writer& StartDict();
+    Writer& EndDict();
+
+    // Продолжает элементы массива верхнего уровня, открытого другим Writer'ом:
+    // так части одного массива можно сериализовать в разные буферы и склеить
+    // без изменений. has_elements — выведены ли до этой части другие элементы
+    Writer& ResumeArray(bool has_elements);
+
+    // Выводит готовый JSON как очередное значение. Текст должен быть сериализован
+    // в том же режиме и на той же глубине вложенности, без начального отступа.
+    // AppendRaw дописывает продолжение этого значения без разделителей
+    Writer& RawValue(std::string_view json);
+    Writer& AppendRaw(std::string_view json);
+
+    // Строковое значение, которое выводится по частям: после StartString каждая часть
+    // передаётся в AppendString без кавычек и экранирования, EndString закрывает строку.
+    // Так большой текст попадает в вывод без сборки в одну строку
+    Writer& StartString();
+    Writer& AppendString(std::string_view part);
+    Writer& EndString();
+
+    // Число байт, выведенных с момента создания, включая ещё не сброшенные
+    size_t Position() const;
+
+    // Сбрасывает накопленные данные в поток
+    void Flush();
+
+private:
+    struct Scope {
+        bool is_dict = false;
+        bool is_first = true;
+        bool has_key = false;
+    };
+
+    std::ostream& output_;
+    std::string buffer_;
+    size_t buffer_size_;
+    std::vector<Scope> scopes_;
+    size_t flushed_size_ = 0;
+    PrintMode mode_;
+    int indent_step_ = 4;
+
+    void BeginValue();
+    void WriteIndent();
+    void WriteNewLine();
+    void WriteString(std::string_view value);
+    void WriteEscaped(std::string_view value);
+    void Write(std::string_view data);
+    void Write(char c);
+};
+
+/*
+ * Буфер потока, который передаёт записанные данные в Writer::AppendString.
+ * Через std::ostream над ним выводится строковое значение, начатое StartString:
+ * любой код, пишущий в поток, сразу выводит экранированный JSON
+ */
+class StringValueBuf final : public std::streambuf {
+public:
+    explicit StringValueBuf(Writer& writer);
+
+    // Число записанных байт до экранирования
+    size_t Size() const;
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+    int_type overflow(int_type c) override;
+
+private:
+    Writer& writer_;
+    size_t size_ = 0;
+};
+
+// Буфер потока, который дописывает данные в строку. В отличие от ostringstream
+// результат не приходится копировать из потока
+class StringAppendBuf final : public std::streambuf {
+public:
+    explicit StringAppendBuf(std::string& output);
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+    int_type overflow(int_type c) override;
+
+private:
+    std::string& output_;
+};
+
+} // namespace json
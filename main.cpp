@@ -1,29 +1,172 @@
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <fstream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "transport_router.h"
 #include "json_reader.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "request_handler.h"
+#include "socket_server.h"
 
 using namespace std::literals;
 
-int main() {
+void PrintUsage(std::ostream& stream = std::cerr) {
+    stream << "Usage: transport_catalogue [--compact | --pretty] [--threads <count>] [--batch-stats] [--pipeline] [--metrics <file | ->] [--startup-report <file | ->] [--ndjson | --socket <path>]\n"sv;
+}
+
+// Одна строка JSON со статистикой пакета запросов
+// "-" означает stderr
+void DumpMetrics(const metrics::RequestMetrics& metrics, const std::string& path) {
+    if (path == "-"sv) {
+        metrics.Print(std::cerr);
+        return;
+    }
+    std::ofstream output(path);
+    if (!output) {
+        std::cerr << "Can't open metrics file: "sv << path << '\n';
+        return;
+    }
+    metrics.Print(output);
+}
+
+// Отчёт о фазах запуска; "-" означает stderr
+void DumpStartupReport(const std::string& path) {
+    if (path == "-"sv) {
+        profiler::PhaseProfiler::Instance().Print(std::cerr);
+        return;
+    }
+    std::ofstream output(path);
+    if (!output) {
+        std::cerr << "Can't open startup report file: "sv << path << '\n';
+        return;
+    }
+    profiler::PhaseProfiler::Instance().Print(output);
+}
+
+void PrintBatchStats(const json_reader::BatchStats& stats, std::ostream& stream = std::cerr) {
+    const double duplicate_ratio = stats.request_count == 0
+            ? 0.0 : static_cast<double>(stats.duplicate_count) / stats.request_count;
+    {
+        json::Writer writer(stream, json::PrintMode::COMPACT);
+        writer.StartDict()
+                .Key("duplicate_ratio"sv).Value(duplicate_ratio)
+                .Key("duplicates"sv).Value(static_cast<int>(stats.duplicate_count))
+                .Key("requests"sv).Value(static_cast<int>(stats.request_count))
+                .Key("saved_ms"sv).Value(stats.saved_seconds * 1000)
+                .EndDict();
+    }
+    stream << '\n';
+}
+
+int main(int argc, char* argv[]) {
     using namespace catalogue;
-    json_reader::JsonReader json_reader(std::cin, std::cout);
+
+    // Режим вывода из командной строки имеет приоритет над "output_settings"
+    std::optional<json::PrintMode> print_mode;
+    bool ndjson = false;
+    std::optional<std::string> socket_path;
+    bool batch_stats = false;
+    bool pipeline = false;
+    std::optional<std::string> metrics_path;
+    std::optional<std::string> startup_report_path;
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg == "--compact"sv) {
+            print_mode = json::PrintMode::COMPACT;
+        } else if (arg == "--pretty"sv) {
+            print_mode = json::PrintMode::PRETTY;
+        } else if (arg == "--ndjson"sv) {
+            ndjson = true;
+        } else if (arg == "--metrics"sv && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (arg == "--startup-report"sv && i + 1 < argc) {
+            startup_report_path = argv[++i];
+        } else if (arg == "--pipeline"sv) {
+            pipeline = true;
+        } else if (arg == "--batch-stats"sv) {
+            batch_stats = true;
+        } else if (arg == "--threads"sv && i + 1 < argc) {
+            const std::string_view value(argv[++i]);
+            const auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(),
+                    thread_count);
+            if (error != std::errc{} || ptr != value.data() + value.size() || thread_count == 0) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (arg == "--socket"sv && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (startup_report_path) {
+        profiler::PhaseProfiler::Instance().Enable();
+    }
+
+    // В режиме NDJSON запросы документа нужны до чтения строк, конвейер не используется
+    json_reader::JsonReader json_reader(std::cin, std::cout, pipeline && !ndjson);
 
     TransportCatalogue catalogue;
     json_reader.FillCatalogue(catalogue);
 
-    renderer::MapRenderer renderer;
-    json_reader.FillRenderer(renderer);
+    // Визуализатор и маршрутизатор строятся при первом запросе Map и Route
+    handler::RequestHandler handler(catalogue,
+            [&json_reader, thread_count](renderer::MapRenderer& renderer) {
+                json_reader.FillRenderer(renderer);
+                renderer.SetThreadCount(thread_count);
+            },
+            [&json_reader](router::RoutingSettings& routing_settings) {
+                json_reader.FillRoutingSettings(routing_settings);
+            });
+    metrics::RequestMetrics metrics;
+    if (metrics_path) {
+        handler.SetMetrics(&metrics);
+    }
+
+    if (startup_report_path) {
+        // Для отчёта визуализатор и маршрутизатор строятся сразу
+        handler.Prepare();
+        DumpStartupReport(*startup_report_path);
+    }
 
-    router::RoutingSettings routing_settings;
-    json_reader.FillRoutingSettings(routing_settings);
+    if (socket_path) {
+        // Запросы из исходного документа отвечаются как обычно, дальше — через сокет
+        const auto stats = json_reader.ProcessRequests(handler,
+                print_mode.value_or(json_reader.GetPrintMode()), thread_count);
+        if (batch_stats) {
+            PrintBatchStats(stats);
+        }
+        std::cout.flush();
+        server::SocketServer server(handler, *socket_path);
+        if (metrics_path) {
+            server.SetDumpHandler([&metrics, &metrics_path] {
+                DumpMetrics(metrics, *metrics_path);
+            });
+        }
+        server.Run();
+    } else if (ndjson) {
+        json_reader.ProcessRequestLines(handler);
+    } else {
+        const auto stats = json_reader.ProcessRequests(handler,
+                print_mode.value_or(json_reader.GetPrintMode()), thread_count);
+        if (batch_stats) {
+            PrintBatchStats(stats);
+        }
+    }
 
-    router::TransportRouter router(catalogue, routing_settings);
-    handler::RequestHandler handler(catalogue, renderer, router);
-    json_reader.ProcessRequests(handler);
+    if (metrics_path) {
+        DumpMetrics(metrics, *metrics_path);
+    }
 }
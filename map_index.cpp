@@ -0,0 +1,238 @@
+#include "map_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+
+namespace {
+
+// В среднем столько остановок приходится на ячейку сетки
+constexpr double STOPS_PER_CELL = 4.0;
+
+template <typename T>
+bool ByName(const T* left, const T* right) {
+    return left->name < right->name;
+}
+
+// Пересекает ли отрезок from-to прямоугольник (отсечение Лианга — Барски)
+bool SegmentIntersects(geo::Coordinates from, geo::Coordinates to, const GeoBox& box) {
+    double t_min = 0.0;
+    double t_max = 1.0;
+    const double deltas[] = {from.lng - to.lng, to.lng - from.lng,
+            from.lat - to.lat, to.lat - from.lat};
+    const double distances[] = {from.lng - box.min.lng, box.max.lng - from.lng,
+            from.lat - box.min.lat, box.max.lat - from.lat};
+    for (int i = 0; i < 4; ++i) {
+        if (deltas[i] == 0.0) {
+            if (distances[i] < 0.0) {
+                return false;
+            }
+            continue;
+        }
+        const double t = distances[i] / deltas[i];
+        if (deltas[i] < 0.0) {
+            t_min = std::max(t_min, t);
+        } else {
+            t_max = std::min(t_max, t);
+        }
+        if (t_min > t_max) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool GeoBox::Contains(geo::Coordinates point) const {
+    return point.lat >= min.lat && point.lat <= max.lat
+            && point.lng >= min.lng && point.lng <= max.lng;
+}
+
+// Участок проходит по столбцам сетки слева направо; в каждом столбце
+// он занимает строки между своими широтами на границах столбца
+template <typename AddCell>
+void MapIndex::ForEachSegmentCell(const Segment& segment, AddCell add) const {
+    geo::Coordinates from = GetStart(segment);
+    geo::Coordinates to = GetEnd(segment);
+    if (from.lng > to.lng) {
+        std::swap(from, to);
+    }
+    const size_t first_column = GetColumn(from.lng);
+    const size_t last_column = GetColumn(to.lng);
+    for (size_t column = first_column; column <= last_column; ++column) {
+        double lat_begin = from.lat;
+        double lat_end = to.lat;
+        if (to.lng > from.lng) {
+            const double slope = (to.lat - from.lat) / (to.lng - from.lng);
+            const double left = std::max(from.lng, bounds_.min.lng + cell_width_ * column);
+            const double right = std::min(to.lng, bounds_.min.lng + cell_width_ * (column + 1));
+            lat_begin = from.lat + slope * (left - from.lng);
+            lat_end = from.lat + slope * (right - from.lng);
+        }
+        const size_t first_row = GetRow(std::min(lat_begin, lat_end));
+        const size_t last_row = GetRow(std::max(lat_begin, lat_end));
+        for (size_t row = first_row; row <= last_row; ++row) {
+            add(row * columns_ + column);
+        }
+    }
+}
+
+MapIndex::MapIndex(const std::vector<const Stop*>& stops, const std::vector<const Bus*>& buses)
+    : stops_(stops)
+    , buses_(buses) {
+    std::sort(stops_.begin(), stops_.end(), ByName<Stop>);
+    std::sort(buses_.begin(), buses_.end(), ByName<Bus>);
+
+    size_t color_ordinal = 0;
+    for (uint32_t bus = 0; bus < buses_.size(); ++bus) {
+        color_ordinals_.push_back(color_ordinal);
+        const size_t stop_count = buses_[bus]->stops.size();
+        if (stop_count == 0) {
+            continue;
+        }
+        ++color_ordinal;
+        for (uint32_t index = 0; index < std::max<size_t>(stop_count - 1, 1); ++index) {
+            segments_.push_back({bus, index});
+        }
+    }
+
+    if (stops_.empty()) {
+        stop_cells_.offsets.assign(2, 0);
+        segment_cells_.offsets.assign(2, 0);
+        return;
+    }
+    bounds_ = {stops_.front()->coordinates, stops_.front()->coordinates};
+    for (const Stop* stop : stops_) {
+        bounds_.min.lat = std::min(bounds_.min.lat, stop->coordinates.lat);
+        bounds_.min.lng = std::min(bounds_.min.lng, stop->coordinates.lng);
+        bounds_.max.lat = std::max(bounds_.max.lat, stop->coordinates.lat);
+        bounds_.max.lng = std::max(bounds_.max.lng, stop->coordinates.lng);
+    }
+    columns_ = rows_ = static_cast<size_t>(std::ceil(std::sqrt(stops_.size() / STOPS_PER_CELL)));
+    if (const double width = bounds_.max.lng - bounds_.min.lng; width > 0.0) {
+        cell_width_ = width / columns_;
+    }
+    if (const double height = bounds_.max.lat - bounds_.min.lat; height > 0.0) {
+        cell_height_ = height / rows_;
+    }
+
+    // Ячейки заполняются в два прохода: подсчёт размеров, затем раскладка
+    auto fill = [this](Cells& cells, size_t item_count, auto for_each_cell) {
+        cells.offsets.assign(columns_ * rows_ + 1, 0);
+        for (uint32_t item = 0; item < item_count; ++item) {
+            for_each_cell(item, [&cells](size_t cell) {
+                ++cells.offsets[cell + 1];
+            });
+        }
+        for (size_t cell = 1; cell < cells.offsets.size(); ++cell) {
+            cells.offsets[cell] += cells.offsets[cell - 1];
+        }
+        cells.items.resize(cells.offsets.back());
+        std::vector<uint32_t> positions(cells.offsets.begin(), cells.offsets.end() - 1);
+        for (uint32_t item = 0; item < item_count; ++item) {
+            for_each_cell(item, [&cells, &positions, item](size_t cell) {
+                cells.items[positions[cell]++] = item;
+            });
+        }
+    };
+    fill(stop_cells_, stops_.size(), [this](uint32_t stop, auto add) {
+        const geo::Coordinates point = stops_[stop]->coordinates;
+        add(GetRow(point.lat) * columns_ + GetColumn(point.lng));
+    });
+    fill(segment_cells_, segments_.size(), [this](uint32_t segment, auto add) {
+        ForEachSegmentCell(segments_[segment], add);
+    });
+}
+
+const GeoBox& MapIndex::GetBounds() const {
+    return bounds_;
+}
+
+GeoBox MapIndex::GetTileBox(const Tile& tile) const {
+    const double parts = std::ldexp(1.0, tile.zoom);
+    const double width = (bounds_.max.lng - bounds_.min.lng) / parts;
+    const double height = (bounds_.max.lat - bounds_.min.lat) / parts;
+    GeoBox box;
+    box.min.lng = bounds_.min.lng + width * tile.x;
+    box.max.lng = bounds_.min.lng + width * (tile.x + 1);
+    box.max.lat = bounds_.max.lat - height * tile.y;
+    box.min.lat = bounds_.max.lat - height * (tile.y + 1);
+    return box;
+}
+
+MapIndex::Visible MapIndex::Find(const GeoBox& box) const {
+    Visible visible;
+    if (stops_.empty() || box.max.lat < bounds_.min.lat || box.min.lat > bounds_.max.lat
+            || box.max.lng < bounds_.min.lng || box.min.lng > bounds_.max.lng) {
+        return visible;
+    }
+    const size_t first_column = GetColumn(box.min.lng);
+    const size_t last_column = GetColumn(box.max.lng);
+    const size_t first_row = GetRow(box.min.lat);
+    const size_t last_row = GetRow(box.max.lat);
+
+    std::vector<uint32_t> stop_ids;
+    std::vector<uint32_t> segment_ids;
+    for (size_t row = first_row; row <= last_row; ++row) {
+        for (size_t column = first_column; column <= last_column; ++column) {
+            const size_t cell = row * columns_ + column;
+            for (uint32_t i = stop_cells_.offsets[cell]; i < stop_cells_.offsets[cell + 1]; ++i) {
+                const uint32_t stop = stop_cells_.items[i];
+                if (box.Contains(stops_[stop]->coordinates)) {
+                    stop_ids.push_back(stop);
+                }
+            }
+            segment_ids.insert(segment_ids.end(),
+                    segment_cells_.items.begin() + segment_cells_.offsets[cell],
+                    segment_cells_.items.begin() + segment_cells_.offsets[cell + 1]);
+        }
+    }
+
+    // Остановки упорядочены по названию, участки — по маршруту, поэтому
+    // сортировка номеров восстанавливает порядок полной карты
+    std::sort(stop_ids.begin(), stop_ids.end());
+    for (uint32_t stop : stop_ids) {
+        visible.stops.push_back(stops_[stop]);
+    }
+    // Участок попадает во все ячейки, которые пересекает
+    std::sort(segment_ids.begin(), segment_ids.end());
+    segment_ids.erase(std::unique(segment_ids.begin(), segment_ids.end()), segment_ids.end());
+    for (uint32_t id : segment_ids) {
+        const Segment& segment = segments_[id];
+        if (SegmentIntersects(GetStart(segment), GetEnd(segment), box)) {
+            visible.segments.push_back(segment);
+        }
+    }
+    return visible;
+}
+
+const Bus& MapIndex::GetBus(uint32_t bus) const {
+    return *buses_[bus];
+}
+
+size_t MapIndex::GetColorOrdinal(uint32_t bus) const {
+    return color_ordinals_[bus];
+}
+
+size_t MapIndex::GetColumn(double lng) const {
+    const double column = std::floor((lng - bounds_.min.lng) / cell_width_);
+    return static_cast<size_t>(std::clamp(column, 0.0, static_cast<double>(columns_ - 1)));
+}
+
+size_t MapIndex::GetRow(double lat) const {
+    const double row = std::floor((lat - bounds_.min.lat) / cell_height_);
+    return static_cast<size_t>(std::clamp(row, 0.0, static_cast<double>(rows_ - 1)));
+}
+
+geo::Coordinates MapIndex::GetStart(const Segment& segment) const {
+    return buses_[segment.bus]->stops[segment.index]->coordinates;
+}
+
+geo::Coordinates MapIndex::GetEnd(const Segment& segment) const {
+    const auto& stops = buses_[segment.bus]->stops;
+    return stops[std::min<size_t>(segment.index + 1, stops.size() - 1)]->coordinates;
+}
+
+} // end namespace renderer
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+#include "domain.h"
+#include "geo.h"
+
+namespace renderer {
+
+using domain::Stop;
+using domain::Bus;
+
+// Прямоугольник в географических координатах: min — юго-западный угол, max — северо-восточный
+struct GeoBox {
+    geo::Coordinates min;
+    geo::Coordinates max;
+
+    bool Contains(geo::Coordinates point) const;
+};
+
+// Часть полной карты: на уровне zoom карта делится на 2^zoom × 2^zoom равных частей,
+// x отсчитывается с запада, y — с севера
+struct Tile {
+    int zoom = 0;
+    int x = 0;
+    int y = 0;
+};
+
+inline constexpr int MAX_TILE_ZOOM = 30;
+
+// Часть карты в запросе Map
+using MapView = std::variant<GeoBox, Tile>;
+
+/*
+ * Индекс остановок и участков маршрутов для отрисовки части карты.
+ * Строится один раз: область, занятую остановками, делит равномерная сетка,
+ * и каждая ячейка хранит остановки в ней и участки маршрутов, которые её пересекают.
+ * Поиск просматривает только ячейки, пересекающие запрошенный прямоугольник,
+ * поэтому его стоимость зависит от видимой части, а не от размера сети
+ */
+class MapIndex {
+public:
+    // Участок маршрута buses[bus] от остановки stops[index] до следующей.
+    // У маршрута из одной остановки один участок нулевой длины
+    struct Segment {
+        uint32_t bus = 0;
+        uint32_t index = 0;
+    };
+
+    struct Visible {
+        // В порядке названий, как на полной карте
+        std::vector<const Stop*> stops;
+        // В порядке названий маршрутов и участков на маршруте
+        std::vector<Segment> segments;
+    };
+
+    MapIndex(const std::vector<const Stop*>& stops, const std::vector<const Bus*>& buses);
+
+    // Область, занятая остановками
+    const GeoBox& GetBounds() const;
+    GeoBox GetTileBox(const Tile& tile) const;
+
+    Visible Find(const GeoBox& box) const;
+
+    const Bus& GetBus(uint32_t bus) const;
+    // Порядковый номер маршрута среди непустых: по нему выбирается цвет палитры
+    size_t GetColorOrdinal(uint32_t bus) const;
+
+private:
+    // Содержимое ячеек хранится подряд: ячейка i занимает [offsets[i], offsets[i + 1])
+    struct Cells {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> items;
+    };
+
+    std::vector<const Stop*> stops_;
+    std::vector<const Bus*> buses_;
+    std::vector<size_t> color_ordinals_;
+    std::vector<Segment> segments_;
+    GeoBox bounds_;
+    size_t columns_ = 1;
+    size_t rows_ = 1;
+    double cell_width_ = 1.0;
+    double cell_height_ = 1.0;
+    Cells stop_cells_;
+    Cells segment_cells_;
+
+    size_t GetColumn(double lng) const;
+    size_t GetRow(double lat) const;
+    geo::Coordinates GetStart(const Segment& segment) const;
+    geo::Coordinates GetEnd(const Segment& segment) const;
+    // Вызывает add(cell) для каждой ячейки, которую может пересечь участок
+    template <typename AddCell>
+    void ForEachSegmentCell(const Segment& segment, AddCell add) const;
+};
+
+} // end namespace renderer
@@ -1,7 +1,14 @@
 #include "map_renderer.h"
 
 #include <algorithm>
-#include <deque>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 
 namespace renderer {
 using namespace std::literals;
@@ -54,6 +61,10 @@ void MapRenderer::SetUnderlayerColor(int r, int g, int b, double opacity) {
     underlayer_color_ = svg::Rgba(r, g, b, opacity);
 }
 
+void MapRenderer::SetUnderlayerColor(svg::Color color) {
+    underlayer_color_ = std::move(color);
+}
+
 void MapRenderer::SetUnderlayerWidth(double underlayer_width) {
     underlayer_width_ = underlayer_width;
 }
@@ -70,160 +81,602 @@ void MapRenderer::SetColorPalette(int r, int g, int b, double opacity) {
     color_palette_.push_back(svg::Rgba(r, g, b, opacity));
 }
 
-renderer::SphereProjector MapRenderer::CreateProjector(const std::vector<const domain::Stop*>& all_stops) const {
-    std::vector<geo::Coordinates> all_coordinates;
-    std::transform(all_stops.begin(), all_stops.end(),
-                std::inserter(all_coordinates, all_coordinates.begin()),
-                [](const domain::Stop* stop) {
-                    return stop->coordinates;
-                });
-    return SphereProjector(all_coordinates.begin(), all_coordinates.end(),
-            width_, height_, padding_);
+void MapRenderer::SetColorPalette(svg::Color color) {
+    color_palette_.push_back(std::move(color));
 }
 
-void MapRenderer::AddRoutes(const std::vector<const domain::Bus*>& all_buses,
-        const renderer::SphereProjector& projector,
-        svg::Document& doc) const {
-    size_t color_id = 0;
+void MapRenderer::SetPrecision(int precision) {
+    precision_ = precision;
+}
 
-    svg::Polyline base_polyline;
-    base_polyline.SetStrokeWidth(line_width_)
-            .SetFillColor(svg::NoneColor)
-            .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-            .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-    svg::Text base_text;
-    base_text.SetOffset(bus_label_offset_)
-            .SetFontSize(bus_label_font_size_)
-            .SetFontFamily("Verdana"s)
-            .SetFontWeight("bold"s);
+void MapRenderer::SetCssClasses(bool css_classes) {
+    css_classes_ = css_classes;
+}
 
-    std::vector<svg::Polyline> polylines;
-    std::vector<svg::Text> texts;
+void MapRenderer::SetSimplifyTolerance(double tolerance) {
+    simplify_tolerance_ = tolerance;
+}
 
-    for (const domain::Bus* bus : all_buses) {
-        if (bus->stops.size() == 0) {
-            continue;
+void MapRenderer::SetThreadCount(size_t thread_count) {
+    thread_count_ = std::max<size_t>(thread_count, 1);
+}
+
+renderer::SphereProjector MapRenderer::CreateProjector(const StopCoordinates& coordinates) const {
+    if (coordinates.lats.empty()) {
+        return CreateProjector(GeoBox{});
+    }
+    return CreateProjector(SphereProjector::FindBounds(
+            ranges::AsSpan(coordinates.lats), ranges::AsSpan(coordinates.lngs)));
+}
+
+renderer::SphereProjector MapRenderer::CreateProjector(const GeoBox& box) const {
+    return SphereProjector(box, width_, height_, padding_);
+}
+
+namespace {
+
+// Точки остановок в порядке их координат, одним пакетом
+std::vector<svg::Point> ProjectStops(const SphereProjector& projector,
+        const StopCoordinates& coordinates) {
+    std::vector<svg::Point> points(coordinates.lats.size());
+    projector.Project(ranges::AsSpan(coordinates.lats), ranges::AsSpan(coordinates.lngs),
+            ranges::AsSpan(points));
+    return points;
+}
+
+// Квадрат расстояния от точки до отрезка from-to
+double SquaredDistance(svg::Point point, svg::Point from, svg::Point to) {
+    const double dx = to.x - from.x;
+    const double dy = to.y - from.y;
+    double px = point.x - from.x;
+    double py = point.y - from.y;
+    if (const double length = dx * dx + dy * dy; length > 0.0) {
+        const double t = std::clamp((px * dx + py * dy) / length, 0.0, 1.0);
+        px -= t * dx;
+        py -= t * dy;
+    }
+    return px * px + py * py;
+}
+
+/*
+ * Вершины одной ломаной в пикселях до вывода. С допуском tolerance > 0 ломаная
+ * перед выводом упрощается алгоритмом Дугласа — Пекера: вершина отбрасывается,
+ * если упрощённая линия проходит от неё не дальше tolerance пикселей.
+ * Первая и последняя вершины остаются всегда. Буферы переиспользуются между ломаными
+ */
+class PolylineBuilder {
+public:
+    explicit PolylineBuilder(double tolerance)
+        : squared_tolerance_(tolerance * tolerance) {
+    }
+
+    void AddPoint(svg::Point point) {
+        points_.push_back(point);
+    }
+
+    void Write(svg::Writer& writer, std::string_view attrs) {
+        writer.StartPolyline();
+        if (squared_tolerance_ > 0.0 && points_.size() > 2) {
+            Simplify();
+            for (size_t i = 0; i < points_.size(); ++i) {
+                if (kept_[i]) {
+                    writer.AddPoint(points_[i]);
+                }
+            }
+        } else {
+            for (svg::Point point : points_) {
+                writer.AddPoint(point);
+            }
         }
+        writer.EndPolyline(attrs);
+        points_.clear();
+    }
 
-        const svg::Color color = color_palette_[color_id++];
-        if (color_id >= color_palette_.size()) {
-            color_id = 0;
+private:
+    double squared_tolerance_;
+    std::vector<svg::Point> points_;
+    std::vector<bool> kept_;
+    // Участки [first, last], которые ещё предстоит упростить
+    std::vector<std::pair<size_t, size_t>> ranges_;
+
+    // Отмечает в kept_ оставляемые вершины. Рекурсия заменена стеком участков,
+    // чтобы длинные маршруты не упирались в глубину стека вызовов
+    void Simplify() {
+        kept_.assign(points_.size(), false);
+        kept_.front() = kept_.back() = true;
+        ranges_.emplace_back(0, points_.size() - 1);
+        while (!ranges_.empty()) {
+            const auto [first, last] = ranges_.back();
+            ranges_.pop_back();
+            double max_distance = squared_tolerance_;
+            size_t farthest = first;
+            for (size_t i = first + 1; i < last; ++i) {
+                const double distance = SquaredDistance(points_[i], points_[first], points_[last]);
+                if (distance > max_distance) {
+                    max_distance = distance;
+                    farthest = i;
+                }
+            }
+            if (farthest == first) {
+                continue;
+            }
+            kept_[farthest] = true;
+            ranges_.emplace_back(first, farthest);
+            ranges_.emplace_back(farthest, last);
         }
+    }
+};
 
-        svg::Polyline polyline{base_polyline};
-        polyline.SetStrokeColor(color);
+// Вершины ломаной маршрута: остановки по порядку, а для некольцевого — ещё и обратно
+void AddRoutePoints(const domain::Bus& bus, const StopPoints& points, PolylineBuilder& polyline) {
+    for (const domain::Stop* stop : bus.stops) {
+        polyline.AddPoint(points(stop));
+    }
+    if (!bus.is_roundtrip) {
+        for (auto it = std::next(bus.stops.rbegin()); it != bus.stops.rend(); ++it) {
+            polyline.AddPoint(points(*it));
+        }
+    }
+}
+
+// Слой карты из count элементов: write выводит элементы [begin, end) слоя
+struct Layer {
+    size_t count = 0;
+    std::function<void(svg::Writer&, size_t, size_t)> write;
+};
+
+// Меньшие части не окупают отдельный буфер
+constexpr size_t MIN_CHUNK_SIZE = 256;
+// Частей на поток больше одной, чтобы потоки, быстро закончившие свои, брали чужие
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+/*
+ * Выводит слои по порядку. При thread_count > 1 слои делятся на части,
+ * каждая часть выводится своим svg::Writer в свой буфер в одном из потоков,
+ * и буферы дописываются в writer в исходном порядке. Порядок элементов от
+ * числа потоков не зависит, поэтому и документ получается тем же
+ */
+void WriteLayers(const std::vector<Layer>& layers, size_t thread_count,
+        svg::Precision precision, svg::Writer& writer) {
+    if (thread_count <= 1) {
+        for (const Layer& layer : layers) {
+            layer.write(writer, 0, layer.count);
+        }
+        return;
+    }
 
-        std::deque<svg::Point> points;
-        for (const auto& stop : bus->stops) {
-            points.push_front(projector(stop->coordinates));
-            polyline.AddPoint(points.front());
+    struct Chunk {
+        const Layer* layer;
+        size_t begin;
+        size_t end;
+        std::string output;
+    };
+    std::vector<Chunk> chunks;
+    for (const Layer& layer : layers) {
+        const size_t chunk_size = std::max(MIN_CHUNK_SIZE,
+                (layer.count + thread_count * CHUNKS_PER_THREAD - 1)
+                        / (thread_count * CHUNKS_PER_THREAD));
+        for (size_t begin = 0; begin < layer.count; begin += chunk_size) {
+            chunks.push_back({&layer, begin, std::min(layer.count, begin + chunk_size), {}});
         }
-        svg::Point end_point = points.front();
-        points.pop_front();
-        if (!bus->is_roundtrip) {
-            for (const auto& point : points) {
-                polyline.AddPoint(point);
+    }
+
+    std::atomic<size_t> next_chunk = 0;
+    std::mutex mutex;
+    std::exception_ptr error;
+    auto work = [&] {
+        std::ostringstream stream;
+        for (size_t index = next_chunk++; index < chunks.size(); index = next_chunk++) {
+            Chunk& chunk = chunks[index];
+            try {
+                {
+                    svg::Writer chunk_writer(stream, precision);
+                    chunk.layer->write(chunk_writer, chunk.begin, chunk.end);
+                }
+                chunk.output = stream.str();
+                stream.str({});
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next_chunk = chunks.size();
+                return;
             }
         }
-        polylines.push_back(polyline);
+    };
+
+    // Вызывающий поток тоже выводит части
+    std::vector<std::thread> workers;
+    const size_t worker_count = std::min(thread_count, chunks.size());
+    for (size_t i = 1; i < worker_count; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    for (const Chunk& chunk : chunks) {
+        writer.Fragment(chunk.output);
+    }
+}
 
-        svg::Text text{base_text};
-        text.SetFillColor(color)
-                .SetPosition(points.back())
-                .SetData(bus->name);
-        svg::Text text_underlayer{text};
-        text_underlayer.SetFillColor(underlayer_color_)
-                .SetStrokeColor(underlayer_color_)
-                .SetStrokeWidth(underlayer_width_)
+void AddCssRule(std::ostream& css, std::string_view class_name, std::string_view declarations) {
+    css << '.' << class_name << '{' << declarations << '}';
+}
+
+} // namespace
+
+MapRenderer::Styles MapRenderer::PrepareStyles() const {
+    // Цвета маршрутов берутся из палитры по кругу, без неё их не назначить
+    if (color_palette_.empty()) {
+        throw std::logic_error("MapRenderer: color palette is empty"s);
+    }
+    svg::Style underlayer;
+    underlayer.SetFillColor(underlayer_color_)
+            .SetStrokeColor(underlayer_color_)
+            .SetStrokeWidth(underlayer_width_)
+            .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+            .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    svg::Style stop;
+    stop.SetFillColor("white"s);
+    svg::Style stop_label;
+    stop_label.SetFillColor("black"s);
+    // Оформление маршрутов зависит только от цвета палитры
+    auto route_style = [this](const svg::Color& color) {
+        svg::Style route;
+        route.SetStrokeWidth(line_width_)
+                .SetFillColor(svg::NoneColor)
+                .SetStrokeColor(color)
                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
                 .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        texts.push_back(text_underlayer);
-        texts.push_back(text);
-
-        if (bus->is_roundtrip || (bus->stops.back() == bus->stops.front())) {
-            continue;
+        return route;
+    };
+    auto bus_label_style = [](const svg::Color& color) {
+        svg::Style bus_label;
+        bus_label.SetFillColor(color);
+        return bus_label;
+    };
+
+    Styles styles;
+    if (!css_classes_) {
+        for (const svg::Color& color : color_palette_) {
+            styles.route.push_back(route_style(color).Render(precision_));
+            styles.bus_label.push_back(bus_label_style(color).Render(precision_));
         }
+        styles.bus_label_underlayer = underlayer.Render(precision_);
+        styles.bus_label_font = svg::RenderFontAttrs(bus_label_offset_, bus_label_font_size_,
+                "Verdana"sv, "bold"sv, precision_);
+        styles.stop = stop.Render(precision_);
+        styles.stop_label = stop_label.Render(precision_);
+        styles.stop_label_underlayer = styles.bus_label_underlayer;
+        styles.stop_label_font = svg::RenderFontAttrs(stop_label_offset_, stop_label_font_size_,
+                "Verdana"sv, {}, precision_);
+        return styles;
+    }
 
-        text_underlayer.SetPosition(end_point);
-        texts.push_back(text_underlayer);
-        text.SetPosition(end_point);
-        texts.push_back(text);
+    // Каждый набор свойств — класс CSS; у элемента остаются только координаты,
+    // смещение подписи и список классов. Классы одного элемента не задают
+    // одинаковых свойств, поэтому их порядок не важен
+    std::ostringstream css;
+    for (size_t i = 0; i < color_palette_.size(); ++i) {
+        const std::string route_class = "r"s + std::to_string(i);
+        const std::string label_class = "c"s + std::to_string(i);
+        AddCssRule(css, route_class, route_style(color_palette_[i]).RenderCss(precision_));
+        AddCssRule(css, label_class, bus_label_style(color_palette_[i]).RenderCss(precision_));
+        styles.route.push_back(svg::RenderClassAttr(route_class));
+        styles.bus_label.push_back(svg::RenderClassAttr("b "s + label_class));
     }
+    AddCssRule(css, "u"sv, underlayer.RenderCss(precision_));
+    AddCssRule(css, "b"sv, svg::RenderFontCss(bus_label_font_size_, "Verdana"sv, "bold"sv));
+    AddCssRule(css, "s"sv, svg::RenderFontCss(stop_label_font_size_, "Verdana"sv));
+    AddCssRule(css, "p"sv, stop.RenderCss(precision_));
+    AddCssRule(css, "l"sv, stop_label.RenderCss(precision_));
+    styles.css = css.str();
+    styles.bus_label_underlayer = svg::RenderClassAttr("u b"sv);
+    styles.bus_label_font = svg::RenderOffsetAttrs(bus_label_offset_, precision_);
+    styles.stop = svg::RenderClassAttr("p"sv);
+    styles.stop_label = svg::RenderClassAttr("s l"sv);
+    styles.stop_label_underlayer = svg::RenderClassAttr("u s"sv);
+    styles.stop_label_font = svg::RenderOffsetAttrs(stop_label_offset_, precision_);
+    return styles;
+}
 
-    for (const auto& polyline: polylines) {
-        doc.Add(polyline);
+std::vector<size_t> MapRenderer::AssignColors(const std::vector<const domain::Bus*>& buses) const {
+    std::vector<size_t> colors(buses.size());
+    size_t color_id = 0;
+    for (size_t i = 0; i < buses.size(); ++i) {
+        if (buses[i]->stops.empty()) {
+            continue;
+        }
+        colors[i] = color_id++;
+        if (color_id >= color_palette_.size()) {
+            color_id = 0;
+        }
     }
-    for (const auto& text: texts) {
-        doc.Add(text);
+    return colors;
+}
+
+void MapRenderer::AddRouteLines(const std::vector<const domain::Bus*>& buses,
+        const std::vector<size_t>& colors, size_t from, size_t to,
+        const StopPoints& points, const Styles& styles, svg::Writer& writer) const {
+    PolylineBuilder polyline(simplify_tolerance_);
+    for (size_t i = from; i < to; ++i) {
+        if (buses[i]->stops.empty()) {
+            continue;
+        }
+        AddRoutePoints(*buses[i], points, polyline);
+        polyline.Write(writer, styles.route[colors[i]]);
     }
 }
 
-void MapRenderer::AddStops(const std::vector<const domain::Stop*>& all_stops,
-        const renderer::SphereProjector& projector,
-        svg::Document& doc) const {
-    svg::Circle base_circle;
-    base_circle.SetFillColor("white"s)
-            .SetRadius(stop_radius_);
-    svg::Text base_text;
-    base_text.SetOffset(stop_label_offset_)
-            .SetFontSize(stop_label_font_size_)
-            .SetFontFamily("Verdana"s);
+void MapRenderer::AddRouteLabels(const std::vector<const domain::Bus*>& buses,
+        const std::vector<size_t>& colors, size_t from, size_t to,
+        const StopPoints& points, const Styles& styles, svg::Writer& writer) const {
+    const std::string& underlayer = styles.bus_label_underlayer;
+    const std::string& font = styles.bus_label_font;
+    for (size_t i = from; i < to; ++i) {
+        const domain::Bus* bus = buses[i];
+        if (bus->stops.empty()) {
+            continue;
+        }
+        const std::string& label = styles.bus_label[colors[i]];
 
-    std::vector<svg::Circle> circles;
-    std::vector<svg::Text> texts;
-    for (const domain::Stop* stop : all_stops) {
-        svg::Point point = projector(stop->coordinates);
+        const svg::Point begin = points(bus->stops.front());
+        writer.Text(underlayer, begin, font, bus->name)
+                .Text(label, begin, font, bus->name);
 
-        svg::Circle circle{base_circle};
-        circle.SetCenter(point);
-        circles.push_back(circle);
+        if (bus->is_roundtrip || (bus->stops.back() == bus->stops.front())) {
+            continue;
+        }
 
-        svg::Text text{base_text};
-        text.SetFillColor("black"s)
-                .SetPosition(point)
-                .SetData(stop->name);
-        svg::Text text_underlayer{text};
-        text_underlayer.SetFillColor(underlayer_color_)
-                .SetStrokeColor(underlayer_color_)
-                .SetStrokeWidth(underlayer_width_)
-                .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-                .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        texts.push_back(text_underlayer);
-        texts.push_back(text);
+        const svg::Point end = points(bus->stops.back());
+        writer.Text(underlayer, end, font, bus->name)
+                .Text(label, end, font, bus->name);
     }
+}
 
-    for (const auto& circle: circles) {
-        doc.Add(circle);
+void MapRenderer::AddStopCircles(const std::vector<svg::Point>& points,
+        size_t from, size_t to, const Styles& styles,
+        svg::Writer& writer) const {
+    for (size_t i = from; i < to; ++i) {
+        writer.Circle(points[i], stop_radius_, styles.stop);
     }
-    for (const auto& text: texts) {
-        doc.Add(text);
+}
+
+void MapRenderer::AddStopLabels(const std::vector<const domain::Stop*>& stops,
+        const std::vector<svg::Point>& points, size_t from, size_t to, const Styles& styles,
+        svg::Writer& writer) const {
+    for (size_t i = from; i < to; ++i) {
+        const svg::Point point = points[i];
+        writer.Text(styles.stop_label_underlayer, point, styles.stop_label_font, stops[i]->name)
+                .Text(styles.stop_label, point, styles.stop_label_font, stops[i]->name);
     }
 }
 
 void MapRenderer::GetMap(std::ostream& out,
         std::vector<const domain::Stop*> all_stops,
         std::vector<const domain::Bus*> all_buses) const {
-    const renderer::SphereProjector projector = CreateProjector(all_stops);
-
-    svg::Document doc;
+    std::sort(all_stops.begin(), all_stops.end(),
+            [](const domain::Stop* left, const domain::Stop* rigth) {
+        return left->name < rigth->name;
+    });
+    // Все остановки проецируются заранее, элементы карты берут готовые точки
+    const StopCoordinates coordinates(all_stops);
+    const std::vector<svg::Point> stop_points = ProjectStops(CreateProjector(coordinates), coordinates);
+    const StopPoints points(all_stops, stop_points);
+
+    const Styles styles = PrepareStyles();
+    svg::Writer writer(out, precision_);
+    writer.StartDocument();
+    if (!styles.css.empty()) {
+        writer.StyleSheet(styles.css);
+    }
 
     std::sort(all_buses.begin(), all_buses.end(),
             [](const domain::Bus* left, const domain::Bus* rigth) {
         return left->name < rigth->name;
     });
-    AddRoutes(all_buses, projector, doc);
+    const std::vector<size_t> colors = AssignColors(all_buses);
+
+    // Сначала все линии, затем названия маршрутов, круги и названия остановок
+    WriteLayers({
+        {all_buses.size(), [&](svg::Writer& layer, size_t begin, size_t end) {
+            AddRouteLines(all_buses, colors, begin, end, points, styles, layer);
+        }},
+        {all_buses.size(), [&](svg::Writer& layer, size_t begin, size_t end) {
+            AddRouteLabels(all_buses, colors, begin, end, points, styles, layer);
+        }},
+        {all_stops.size(), [&](svg::Writer& layer, size_t begin, size_t end) {
+            AddStopCircles(stop_points, begin, end, styles, layer);
+        }},
+        {all_stops.size(), [&](svg::Writer& layer, size_t begin, size_t end) {
+            AddStopLabels(all_stops, stop_points, begin, end, styles, layer);
+        }},
+    }, thread_count_, precision_, writer);
+
+    writer.EndDocument();
+}
 
-    std::sort(all_stops.begin(), all_stops.end(),
-            [](const domain::Stop* left, const domain::Stop* rigth) {
-        return left->name < rigth->name;
-    });
-    AddStops(all_stops, projector, doc);
+void MapRenderer::AddRouteSegments(const MapIndex& index,
+        const std::vector<MapIndex::Segment>& segments, const GeoBox& box,
+        const renderer::SphereProjector& projector, const Styles& styles,
+        svg::Writer& writer) const {
+    // Подряд идущие участки одного маршрута выводятся одной ломаной
+    PolylineBuilder polyline(simplify_tolerance_);
+    for (size_t i = 0; i < segments.size();) {
+        const uint32_t bus_id = segments[i].bus;
+        const domain::Bus& bus = index.GetBus(bus_id);
+        size_t last = segments[i].index;
+        polyline.AddPoint(projector(bus.stops[last]->coordinates));
+        for (; i < segments.size() && segments[i].bus == bus_id && segments[i].index == last; ++i) {
+            if (last + 1 < bus.stops.size()) {
+                polyline.AddPoint(projector(bus.stops[++last]->coordinates));
+            }
+        }
+        polyline.Write(writer, styles.route[index.GetColorOrdinal(bus_id) % color_palette_.size()]);
+    }
 
-    doc.Render(out);
+    // Названия — у конечных остановок, попавших в область
+    const std::string& underlayer = styles.bus_label_underlayer;
+    const std::string& font = styles.bus_label_font;
+    for (size_t i = 0; i < segments.size();) {
+        const uint32_t bus_id = segments[i].bus;
+        const domain::Bus& bus = index.GetBus(bus_id);
+        const std::string& label = styles.bus_label[
+                index.GetColorOrdinal(bus_id) % color_palette_.size()];
+        const bool has_first = segments[i].index == 0;
+        for (; i + 1 < segments.size() && segments[i + 1].bus == bus_id; ++i) {
+        }
+        const bool has_last = segments[i].index + 2 >= bus.stops.size();
+        ++i;
+
+        const domain::Stop* first = bus.stops.front();
+        if (has_first && box.Contains(first->coordinates)) {
+            const svg::Point point = projector(first->coordinates);
+            writer.Text(underlayer, point, font, bus.name)
+                    .Text(label, point, font, bus.name);
+        }
+        const domain::Stop* last = bus.stops.back();
+        if (bus.is_roundtrip || last == first) {
+            continue;
+        }
+        if (has_last && box.Contains(last->coordinates)) {
+            const svg::Point point = projector(last->coordinates);
+            writer.Text(underlayer, point, font, bus.name)
+                    .Text(label, point, font, bus.name);
+        }
+    }
+}
+
+void MapRenderer::GetMapView(std::ostream& out, const MapIndex& index, const GeoBox& box) const {
+    const renderer::SphereProjector projector = CreateProjector(box);
+    const MapIndex::Visible visible = index.Find(box);
+
+    const Styles styles = PrepareStyles();
+    svg::Writer writer(out, precision_);
+    writer.StartDocument();
+    if (!styles.css.empty()) {
+        writer.StyleSheet(styles.css);
+    }
+    AddRouteSegments(index, visible.segments, box, projector, styles, writer);
+    // Видимые остановки проецируются по порядку, без таблицы по номерам всего справочника
+    const std::vector<svg::Point> points = ProjectStops(projector, StopCoordinates(visible.stops));
+    AddStopCircles(points, 0, visible.stops.size(), styles, writer);
+    AddStopLabels(visible.stops, points, 0, visible.stops.size(), styles, writer);
+    writer.EndDocument();
+}
+
+/* ------------- StopPoints ---------------- */
+
+StopCoordinates::StopCoordinates(const std::vector<const Stop*>& stops) {
+    lats.reserve(stops.size());
+    lngs.reserve(stops.size());
+    for (const Stop* stop : stops) {
+        lats.push_back(stop->coordinates.lat);
+        lngs.push_back(stop->coordinates.lng);
+    }
+}
+
+StopPoints::StopPoints(const std::vector<const Stop*>& stops,
+        const std::vector<svg::Point>& points) {
+    size_t id_count = 0;
+    for (const Stop* stop : stops) {
+        id_count = std::max(id_count, stop->id + 1);
+    }
+    points_.resize(id_count);
+    for (size_t i = 0; i < stops.size(); ++i) {
+        points_[stops[i]->id] = points[i];
+    }
 }
 
 /* ------------- SphereProjector ---------------- */
 
+SphereProjector::SphereProjector(const GeoBox& bounds,
+        double max_width, double max_height, double padding)
+    : padding_(padding) {
+    SetBounds(bounds, max_width, max_height);
+}
+
+void SphereProjector::SetBounds(const GeoBox& bounds, double max_width, double max_height) {
+    min_lon_ = bounds.min.lng;
+    max_lat_ = bounds.max.lat;
+
+    std::optional<double> width_zoom;
+    if (!IsZero(bounds.max.lng - min_lon_)) {
+        width_zoom = (max_width - 2 * padding_) / (bounds.max.lng - min_lon_);
+    }
+
+    std::optional<double> height_zoom;
+    if (!IsZero(max_lat_ - bounds.min.lat)) {
+        height_zoom = (max_height - 2 * padding_) / (max_lat_ - bounds.min.lat);
+    }
+
+    if (width_zoom && height_zoom) {
+        zoom_coeff_ = std::min(*width_zoom, *height_zoom);
+    } else if (width_zoom) {
+        zoom_coeff_ = *width_zoom;
+    } else if (height_zoom) {
+        zoom_coeff_ = *height_zoom;
+    }
+}
+
+GeoBox SphereProjector::FindBounds(ranges::Span<const double> lats,
+        ranges::Span<const double> lngs) {
+    // Минимумы и максимумы копятся по LANES независимым дорожкам: такой цикл
+    // компилятор переводит в векторные min/max, а дорожки сводятся в конце
+    constexpr size_t LANES = 4;
+    const double* lat = lats.begin();
+    const double* lng = lngs.begin();
+    const size_t count = lats.size();
+    double min_lat[LANES];
+    double max_lat[LANES];
+    double min_lng[LANES];
+    double max_lng[LANES];
+    std::fill_n(min_lat, LANES, lat[0]);
+    std::fill_n(max_lat, LANES, lat[0]);
+    std::fill_n(min_lng, LANES, lng[0]);
+    std::fill_n(max_lng, LANES, lng[0]);
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            min_lat[lane] = lat[i + lane] < min_lat[lane] ? lat[i + lane] : min_lat[lane];
+            max_lat[lane] = max_lat[lane] < lat[i + lane] ? lat[i + lane] : max_lat[lane];
+            min_lng[lane] = lng[i + lane] < min_lng[lane] ? lng[i + lane] : min_lng[lane];
+            max_lng[lane] = max_lng[lane] < lng[i + lane] ? lng[i + lane] : max_lng[lane];
+        }
+    }
+
+    GeoBox bounds{{min_lat[0], min_lng[0]}, {max_lat[0], max_lng[0]}};
+    for (size_t lane = 1; lane < LANES; ++lane) {
+        bounds.min.lat = std::min(bounds.min.lat, min_lat[lane]);
+        bounds.max.lat = std::max(bounds.max.lat, max_lat[lane]);
+        bounds.min.lng = std::min(bounds.min.lng, min_lng[lane]);
+        bounds.max.lng = std::max(bounds.max.lng, max_lng[lane]);
+    }
+    for (; i < count; ++i) {
+        bounds.min.lat = std::min(bounds.min.lat, lat[i]);
+        bounds.max.lat = std::max(bounds.max.lat, lat[i]);
+        bounds.min.lng = std::min(bounds.min.lng, lng[i]);
+        bounds.max.lng = std::max(bounds.max.lng, lng[i]);
+    }
+    return bounds;
+}
+
+void SphereProjector::Project(ranges::Span<const double> lats, ranges::Span<const double> lngs,
+        ranges::Span<svg::Point> points) const {
+    const double* lat = lats.begin();
+    const double* lng = lngs.begin();
+    svg::Point* point = points.begin();
+    for (size_t i = 0; i < points.size(); ++i) {
+        point[i].x = (lng[i] - min_lon_) * zoom_coeff_ + padding_;
+        point[i].y = (max_lat_ - lat[i]) * zoom_coeff_ + padding_;
+    }
+}
+
 svg::Point SphereProjector::operator()(geo::Coordinates coords) const {
     return {(coords.lng - min_lon_) * zoom_coeff_ + padding_,
             (max_lat_ - coords.lat) * zoom_coeff_ + padding_};
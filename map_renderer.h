@@ -1,30 +1,74 @@
 #pragma once
 
+#include <string>
 #include <vector>
 #include <algorithm>
 
 #include "svg.h"
+#include "svg_writer.h"
 #include "geo.h"
 #include "domain.h"
+#include "map_index.h"
+#include "ranges.h"
 
 namespace renderer {
 
 using domain::Stop;
 using domain::Bus;
 
+// Широты и долготы остановок отдельными массивами, в порядке остановок. Над такими
+// массивами границы и проекция считаются простыми циклами, которые компилятор векторизует
+struct StopCoordinates {
+    explicit StopCoordinates(const std::vector<const Stop*>& stops);
+
+    std::vector<double> lats;
+    std::vector<double> lngs;
+};
+
 class SphereProjector {
 public:
     template <typename PointInputIt>
     SphereProjector(PointInputIt points_begin, PointInputIt points_end,
                     double max_width, double max_height, double padding);
 
+    // Проекция по готовым границам точек
+    SphereProjector(const GeoBox& bounds, double max_width, double max_height, double padding);
+
+    // Границы точек за один проход по массивам; массивы одного размера и не пусты
+    static GeoBox FindBounds(ranges::Span<const double> lats, ranges::Span<const double> lngs);
+
     svg::Point operator()(geo::Coordinates coords) const;
 
+    // Проецирует точки массивов в points того же размера; результат совпадает
+    // с operator() для каждой точки
+    void Project(ranges::Span<const double> lats, ranges::Span<const double> lngs,
+            ranges::Span<svg::Point> points) const;
+
 private:
     double padding_;
     double min_lon_ = 0;
     double max_lat_ = 0;
     double zoom_coeff_ = 0;
+
+    void SetBounds(const GeoBox& bounds, double max_width, double max_height);
+};
+
+/*
+ * Точки остановок полной карты по номерам остановок: маршруты, проходящие через
+ * остановку, берут её готовую точку. Таблица занимает место по наибольшему номеру,
+ * поэтому строится только для полной карты. Номера остановок должны быть из одного справочника
+ */
+class StopPoints {
+public:
+    // points[i] — точка остановки stops[i]
+    StopPoints(const std::vector<const Stop*>& stops, const std::vector<svg::Point>& points);
+
+    svg::Point operator()(const Stop* stop) const {
+        return points_[stop->id];
+    }
+
+private:
+    std::vector<svg::Point> points_;
 };
 
 class MapRenderer {
@@ -42,13 +86,35 @@ public:
     void SetUnderlayerColor(std::string color);
     void SetUnderlayerColor(int r, int g, int b);
     void SetUnderlayerColor(int r, int g, int b, double opacity);
+    void SetUnderlayerColor(svg::Color color);
 
     void SetColorPalette(std::string color);
     void SetColorPalette(int r, int g, int b);
     void SetColorPalette(int r, int g, int b, double opacity);
+    void SetColorPalette(svg::Color color);
 
+    // Число знаков после запятой для всех чисел карты; по умолчанию — до 6 значащих цифр
+    void SetPrecision(int precision);
+
+    // Оформление элементов выводится классами CSS в элементе <style>,
+    // а не атрибутами каждого элемента
+    void SetCssClasses(bool css_classes);
+
+    // Допуск упрощения линий маршрутов в пикселях: вершины, от которых упрощённая
+    // линия отклоняется не больше допуска, не выводятся. 0 — без упрощения
+    void SetSimplifyTolerance(double tolerance);
+
+    // Число потоков, в которых выводится полная карта; документ от него не зависит
+    void SetThreadCount(size_t thread_count);
+
+    // Карта строится только с непустой палитрой, иначе бросается std::logic_error
     void GetMap(std::ostream&, std::vector<const Stop*>, std::vector<const Bus*>) const;
 
+    // Часть карты: остановки и участки маршрутов, которые индекс нашёл в box.
+    // Прямоугольник box растягивается на весь холст; порядок элементов и цвета
+    // маршрутов те же, что на полной карте
+    void GetMapView(std::ostream&, const MapIndex& index, const GeoBox& box) const;
+
 private:
     double width_ = 0.0;                    // ширина в пикселях
     double height_ = 0.0;                   // высота в пикселях
@@ -62,10 +128,43 @@ private:
     svg::Color underlayer_color_;           // цвет тени текстов
     double underlayer_width_ = 0.0;         // толщина тени текстов
     std::vector<svg::Color> color_palette_; //цветовая палитра
-
-    SphereProjector CreateProjector(const std::vector<const Stop*>& all_stops) const;
-    void AddRoutes(const std::vector<const Bus*>&, const renderer::SphereProjector&, svg::Document&) const;
-    void AddStops(const std::vector<const Stop*>&, const renderer::SphereProjector&, svg::Document&) const;
+    svg::Precision precision_;              // знаков после запятой в числах
+    bool css_classes_ = false;              // оформление классами CSS
+    double simplify_tolerance_ = 0.0;       // допуск упрощения линий в пикселях
+    size_t thread_count_ = 1;               // потоки вывода полной карты
+
+    // Оформление элементов, подготовленное один раз на карту: строки атрибутов
+    // или, в режиме классов CSS, атрибуты class и таблица стилей
+    struct Styles {
+        std::vector<std::string> route;     // по цветам палитры
+        std::vector<std::string> bus_label; // по цветам палитры
+        std::string bus_label_underlayer;
+        std::string bus_label_font;
+        std::string stop;
+        std::string stop_label;
+        std::string stop_label_underlayer;
+        std::string stop_label_font;
+        std::string css;
+    };
+
+    SphereProjector CreateProjector(const StopCoordinates& coordinates) const;
+    // Проекция, растягивающая box на весь холст
+    SphereProjector CreateProjector(const GeoBox& box) const;
+    Styles PrepareStyles() const;
+    // Номер цвета палитры для каждого маршрута; маршруты без остановок цвет не занимают
+    std::vector<size_t> AssignColors(const std::vector<const Bus*>&) const;
+    // Элементы слоёв карты для маршрутов и остановок с номерами [from, to)
+    void AddRouteLines(const std::vector<const Bus*>&, const std::vector<size_t>& colors,
+            size_t from, size_t to, const StopPoints&, const Styles&, svg::Writer&) const;
+    void AddRouteLabels(const std::vector<const Bus*>&, const std::vector<size_t>& colors,
+            size_t from, size_t to, const StopPoints&, const Styles&, svg::Writer&) const;
+    // Точки остановок передаются в том же порядке, что и сами остановки
+    void AddStopCircles(const std::vector<svg::Point>& points,
+            size_t from, size_t to, const Styles&, svg::Writer&) const;
+    void AddStopLabels(const std::vector<const Stop*>&, const std::vector<svg::Point>& points,
+            size_t from, size_t to, const Styles&, svg::Writer&) const;
+    void AddRouteSegments(const MapIndex&, const std::vector<MapIndex::Segment>&, const GeoBox&,
+            const renderer::SphereProjector&, const Styles&, svg::Writer&) const;
 };
 
 inline const double EPSILON = 1e-6;
@@ -86,33 +185,12 @@ SphereProjector::SphereProjector(PointInputIt points_begin,
         = std::minmax_element(points_begin, points_end, [](auto lhs, auto rhs) {
               return lhs.lng < rhs.lng;
           });
-    min_lon_ = left_it->lng;
-    const double max_lon = right_it->lng;
-
     const auto [bottom_it, top_it]
         = std::minmax_element(points_begin, points_end, [](auto lhs, auto rhs) {
               return lhs.lat < rhs.lat;
           });
-    const double min_lat = bottom_it->lat;
-    max_lat_ = top_it->lat;
-
-    std::optional<double> width_zoom;
-    if (!IsZero(max_lon - min_lon_)) {
-        width_zoom = (max_width - 2 * padding) / (max_lon - min_lon_);
-    }
-
-    std::optional<double> height_zoom;
-    if (!IsZero(max_lat_ - min_lat)) {
-        height_zoom = (max_height - 2 * padding) / (max_lat_ - min_lat);
-    }
-
-    if (width_zoom && height_zoom) {
-        zoom_coeff_ = std::min(*width_zoom, *height_zoom);
-    } else if (width_zoom) {
-        zoom_coeff_ = *width_zoom;
-    } else if (height_zoom) {
-        zoom_coeff_ = *height_zoom;
-    }
+    SetBounds({{bottom_it->lat, left_it->lng}, {top_it->lat, right_it->lng}},
+            max_width, max_height);
 }
 
 } // end namespace renderer
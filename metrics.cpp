@@ -0,0 +1,145 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
+namespace metrics {
+
+using namespace std::literals;
+
+namespace {
+
+size_t BucketIndex(std::uint64_t value) {
+    size_t bits = 0;
+    while (value != 0) {
+        value >>= 1;
+        ++bits;
+    }
+    return bits;
+}
+
+// Наибольшее значение, попадающее в корзину
+std::uint64_t BucketUpperBound(size_t index) {
+    if (index == 0) {
+        return 0;
+    }
+    if (index >= 64) {
+        return UINT64_MAX;
+    }
+    return (std::uint64_t{1} << index) - 1;
+}
+
+std::int64_t ToJsonInt(std::uint64_t value) {
+    return static_cast<std::int64_t>(std::min<std::uint64_t>(value, INT64_MAX));
+}
+
+constexpr std::string_view KIND_NAMES[] = {"Bus"sv, "Map"sv, "Route"sv, "Stop"sv};
+constexpr RequestKind KINDS_BY_NAME[] = {
+        RequestKind::BUS, RequestKind::MAP, RequestKind::ROUTE, RequestKind::STOP};
+
+} // namespace
+
+void Histogram::Record(std::uint64_t value) {
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    std::uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::uint64_t Histogram::GetCount() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::Percentile(double fraction) const {
+    const std::uint64_t count = GetCount();
+    if (count == 0) {
+        return 0;
+    }
+    const auto rank = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(count))));
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(BucketUpperBound(i), max_.load(std::memory_order_relaxed));
+        }
+    }
+    return max_.load(std::memory_order_relaxed);
+}
+
+void Histogram::Print(json::Writer& writer) const {
+    writer.StartDict().Key("buckets"sv).StartArray();
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        const std::uint64_t count = buckets_[i].load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        writer.StartDict()
+                .Key("count"sv).Value(ToJsonInt(count))
+                .Key("le"sv).Value(ToJsonInt(BucketUpperBound(i)))
+                .EndDict();
+    }
+    writer.EndArray()
+            .Key("count"sv).Value(ToJsonInt(GetCount()))
+            .Key("max"sv).Value(ToJsonInt(max_.load(std::memory_order_relaxed)))
+            .Key("p50"sv).Value(ToJsonInt(Percentile(0.5)))
+            .Key("p90"sv).Value(ToJsonInt(Percentile(0.9)))
+            .Key("p99"sv).Value(ToJsonInt(Percentile(0.99)))
+            .Key("sum"sv).Value(ToJsonInt(sum_.load(std::memory_order_relaxed)))
+            .EndDict();
+}
+
+void RequestMetrics::RecordLatency(RequestKind kind, std::chrono::steady_clock::duration elapsed) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    kinds_[static_cast<size_t>(kind)].latency_ns.Record(static_cast<std::uint64_t>(ns));
+}
+
+void RequestMetrics::RecordNotFound(RequestKind kind) {
+    kinds_[static_cast<size_t>(kind)].not_found.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RequestMetrics::RecordRouteEdges(std::uint64_t edges) {
+    route_edges_.Record(edges);
+}
+
+void RequestMetrics::RecordSvgBytes(std::uint64_t bytes) {
+    svg_bytes_.Record(bytes);
+}
+
+void RequestMetrics::RecordMapCache(bool hit) {
+    (hit ? map_cache_hits_ : map_cache_misses_).fetch_add(1, std::memory_order_relaxed);
+}
+
+void RequestMetrics::Print(std::ostream& output) const {
+    json::Writer writer(output, json::PrintMode::COMPACT);
+    const std::uint64_t hits = map_cache_hits_.load(std::memory_order_relaxed);
+    const std::uint64_t misses = map_cache_misses_.load(std::memory_order_relaxed);
+    const std::uint64_t lookups = hits + misses;
+    writer.StartDict().Key("map_cache"sv).StartDict()
+            .Key("hit_rate"sv).Value(lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups)
+            .Key("hits"sv).Value(ToJsonInt(hits))
+            .Key("misses"sv).Value(ToJsonInt(misses))
+            .EndDict();
+    writer.Key("requests"sv).StartDict();
+    for (size_t i = 0; i < std::size(KIND_NAMES); ++i) {
+        const KindMetrics& kind = kinds_[static_cast<size_t>(KINDS_BY_NAME[i])];
+        writer.Key(KIND_NAMES[i]).StartDict()
+                .Key("latency_ns"sv);
+        kind.latency_ns.Print(writer);
+        writer.Key("not_found"sv).Value(ToJsonInt(kind.not_found.load(std::memory_order_relaxed)))
+                .EndDict();
+    }
+    writer.EndDict().Key("route_edges"sv);
+    route_edges_.Print(writer);
+    writer.Key("svg_bytes"sv);
+    svg_bytes_.Print(writer);
+    writer.EndDict();
+    writer.Flush();
+    output << '\n';
+}
+
+} // end namespace metrics
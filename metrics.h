@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "json_writer.h"
+
+namespace metrics {
+
+/*
+ * Гистограмма с корзинами по степеням двойки: значение v попадает в корзину
+ * с номером, равным числу значащих бит v. Запись — несколько атомарных
+ * операций без блокировок, поэтому её можно вести из любого числа потоков
+ */
+class Histogram {
+public:
+    void Record(std::uint64_t value);
+
+    std::uint64_t GetCount() const;
+
+    // {"buckets": [{"count", "le"}...], "count", "max", "p50", "p90", "p99", "sum"};
+    // перцентили оцениваются верхней границей корзины
+    void Print(json::Writer& writer) const;
+
+private:
+    static constexpr size_t BUCKET_COUNT = 65;
+
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<std::uint64_t> count_ = 0;
+    std::atomic<std::uint64_t> sum_ = 0;
+    std::atomic<std::uint64_t> max_ = 0;
+
+    std::uint64_t Percentile(double fraction) const;
+};
+
+enum class RequestKind {
+    BUS,
+    STOP,
+    MAP,
+    ROUTE,
+    COUNT,
+};
+
+/*
+ * Счётчики обработки запросов: гистограмма задержек в наносекундах и число
+ * ненайденных результатов для каждого типа запроса, длины маршрутов в рёбрах
+ * графа (поездках), объём выданных SVG и попадания в кеш карты
+ */
+class RequestMetrics {
+public:
+    // Время одного запроса; запросы пакета записываются каждый отдельно
+    void RecordLatency(RequestKind kind, std::chrono::steady_clock::duration elapsed);
+    void RecordNotFound(RequestKind kind);
+    void RecordRouteEdges(std::uint64_t edges);
+    void RecordSvgBytes(std::uint64_t bytes);
+    // hit — карта взята из кеша, а не построена заново
+    void RecordMapCache(bool hit);
+
+    // Одна строка JSON
+    void Print(std::ostream& output) const;
+
+private:
+    struct KindMetrics {
+        Histogram latency_ns;
+        std::atomic<std::uint64_t> not_found = 0;
+    };
+
+    std::array<KindMetrics, static_cast<size_t>(RequestKind::COUNT)> kinds_;
+    Histogram route_edges_;
+    Histogram svg_bytes_;
+    std::atomic<std::uint64_t> map_cache_hits_ = 0;
+    std::atomic<std::uint64_t> map_cache_misses_ = 0;
+};
+
+} // end namespace metrics
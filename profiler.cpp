@@ -0,0 +1,176 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#include <sys/resource.h>
+
+#include "json_writer.h"
+
+namespace profiler {
+
+using namespace std::literals;
+
+namespace {
+
+std::atomic<bool> count_allocations = false;
+std::atomic<std::uint64_t> allocation_count = 0;
+std::atomic<std::uint64_t> allocation_bytes = 0;
+
+double ProcessCpuMs() {
+    timespec time{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1'000'000.0;
+}
+
+long PeakRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+std::int64_t ToJsonInt(std::uint64_t value) {
+    return static_cast<std::int64_t>(value);
+}
+
+} // namespace
+
+void CountAllocation(std::size_t size) {
+    if (count_allocations.load(std::memory_order_relaxed)) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+AllocationCounters GetAllocationCounters() {
+    return {allocation_count.load(std::memory_order_relaxed),
+            allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+PhaseProfiler& PhaseProfiler::Instance() {
+    static PhaseProfiler profiler;
+    return profiler;
+}
+
+void PhaseProfiler::Enable() {
+    count_allocations.store(true, std::memory_order_relaxed);
+}
+
+bool PhaseProfiler::IsEnabled() const {
+    return count_allocations.load(std::memory_order_relaxed);
+}
+
+void PhaseProfiler::Record(PhaseRecord record) {
+    std::lock_guard guard(mutex_);
+    phases_.push_back(std::move(record));
+}
+
+void PhaseProfiler::Print(std::ostream& output) const {
+    std::lock_guard guard(mutex_);
+    {
+        json::Writer writer(output, json::PrintMode::COMPACT);
+        writer.StartDict()
+                .Key("peak_rss_kb"sv).Value(static_cast<std::int64_t>(PeakRssKb()))
+                .Key("phases"sv).StartArray();
+        for (const PhaseRecord& phase : phases_) {
+            writer.StartDict()
+                    .Key("allocated_bytes"sv).Value(ToJsonInt(phase.allocated_bytes))
+                    .Key("allocations"sv).Value(ToJsonInt(phase.allocations))
+                    .Key("cpu_ms"sv).Value(phase.cpu_ms)
+                    .Key("name"sv).Value(phase.name)
+                    .Key("peak_rss_kb"sv).Value(static_cast<std::int64_t>(phase.peak_rss_kb))
+                    .Key("wall_ms"sv).Value(phase.wall_ms)
+                    .EndDict();
+        }
+        writer.EndArray().EndDict();
+    }
+    output << '\n';
+}
+
+ScopedPhase::ScopedPhase(std::string_view name)
+    : enabled_(PhaseProfiler::Instance().IsEnabled())
+    , name_(name) {
+    if (enabled_) {
+        allocations_start_ = GetAllocationCounters();
+        cpu_start_ms_ = ProcessCpuMs();
+        wall_start_ = std::chrono::steady_clock::now();
+    }
+}
+
+ScopedPhase::~ScopedPhase() {
+    if (!enabled_) {
+        return;
+    }
+    PhaseRecord record;
+    record.wall_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - wall_start_).count();
+    record.cpu_ms = ProcessCpuMs() - cpu_start_ms_;
+    const AllocationCounters allocations = GetAllocationCounters();
+    record.allocations = allocations.count - allocations_start_.count;
+    record.allocated_bytes = allocations.bytes - allocations_start_.bytes;
+    record.peak_rss_kb = PeakRssKb();
+    record.name = std::string(name_);
+    PhaseProfiler::Instance().Record(std::move(record));
+}
+
+} // end namespace profiler
+
+// Замена глобальных operator new/delete для подсчёта выделений. Массивные
+// и nothrow-версии по умолчанию вызывают эти, поэтому учитываются тоже
+
+namespace {
+
+template <typename Allocate>
+void* AllocateOrThrow(Allocate allocate) {
+    while (true) {
+        if (void* pointer = allocate()) {
+            return pointer;
+        }
+        const std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    profiler::CountAllocation(size);
+    if (size == 0) {
+        size = 1;
+    }
+    return AllocateOrThrow([size] {
+        return std::malloc(size);
+    });
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    profiler::CountAllocation(size);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc требует размер, кратный выравниванию
+    const std::size_t aligned_size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+    return AllocateOrThrow([aligned_size, align] {
+        return std::aligned_alloc(align, aligned_size);
+    });
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace profiler {
+
+struct AllocationCounters {
+    std::uint64_t count = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Число и объём выделений через operator new с момента включения профилировщика
+AllocationCounters GetAllocationCounters();
+
+// Вызывается заменённым operator new
+void CountAllocation(std::size_t size);
+
+struct PhaseRecord {
+    std::string name;
+    double wall_ms = 0.0;
+    double cpu_ms = 0.0;
+    // Пиковый размер резидентной памяти процесса к концу фазы
+    long peak_rss_kb = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+};
+
+/*
+ * Отчёт о фазах запуска: время (реальное и процессорное), пиковая память
+ * и выделения памяти по каждой фазе. Пока профилировщик выключен,
+ * ScopedPhase ничего не замеряет и выделения не считаются
+ */
+class PhaseProfiler {
+public:
+    static PhaseProfiler& Instance();
+
+    void Enable();
+    bool IsEnabled() const;
+
+    void Record(PhaseRecord record);
+
+    // Одна строка JSON: {"peak_rss_kb", "phases": [...]}
+    void Print(std::ostream& output) const;
+
+private:
+    PhaseProfiler() = default;
+
+    mutable std::mutex mutex_;
+    std::vector<PhaseRecord> phases_;
+};
+
+// Замеряет фазу от создания до разрушения объекта
+class ScopedPhase {
+public:
+    explicit ScopedPhase(std::string_view name);
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    bool enabled_;
+    std::string_view name_;
+    std::chrono::steady_clock::time_point wall_start_;
+    double cpu_start_ms_ = 0.0;
+    AllocationCounters allocations_start_;
+};
+
+} // end namespace profiler
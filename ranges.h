@@ -2,6 +2,7 @@
 
 #include <iterator>
 #include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -22,6 +23,12 @@ public:
     It end() const {
         return end_;
     }
+    size_t size() const {
+        return static_cast<size_t>(std::distance(begin_, end_));
+    }
+    decltype(auto) operator[](size_t index) const {
+        return begin_[index];
+    }
 
 private:
     It begin_;
@@ -33,4 +40,14 @@ auto AsRange(const C& container) {
     return Range{container.begin(), container.end()};
 }
 
+// Непрерывный участок массива, аналог std::span
+template <typename T>
+using Span = Range<T*>;
+
+template <typename C>
+auto AsSpan(C& container) {
+    return Span<std::remove_pointer_t<decltype(container.data())>>{
+            container.data(), container.data() + container.size()};
+}
+
 }  // namespace ranges
@@ -1,42 +1,285 @@
 #include "request_handler.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <deque>
-#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <variant>
+
+#include "json_writer.h"
 
 namespace handler {
 
 using namespace std::literals;
 
 RequestHandler::RequestHandler(const catalogue::TransportCatalogue& catalogue,
-        const renderer::MapRenderer& renderer,
-        const router::TransportRouter& router)
+        RendererSetup setup_renderer, RoutingSetup setup_routing)
     : catalogue_(catalogue)
-    , renderer_(renderer)
-    , router_(router) {
+    , setup_renderer_(std::move(setup_renderer))
+    , setup_routing_(std::move(setup_routing)) {
+    }
+
+std::uint64_t CountRouteEdges(const domain::RouteInfo& route) {
+    return std::count_if(route.items.begin(), route.items.end(), [](const domain::RouteItem& item) {
+        return item.type == domain::RouteItem::Type::BUS;
+    });
+}
+
+namespace {
+
+using metrics::RequestKind;
+
+// Замеряет время вызова, если сбор метрик включён. Ленивое построение
+// рендерера, индекса и маршрутизатора выполняется до создания таймера
+class LatencyTimer {
+public:
+    LatencyTimer(metrics::RequestMetrics* metrics, RequestKind kind)
+        : metrics_(metrics)
+        , kind_(kind) {
+        if (metrics_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~LatencyTimer() {
+        if (metrics_) {
+            metrics_->RecordLatency(kind_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+private:
+    metrics::RequestMetrics* metrics_;
+    RequestKind kind_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+
+// Карта, которую render выводит в поток, сразу экранируется в строковое значение
+// JSON: svg::Writer и json::Writer передают её друг другу блоками своих буферов.
+// Возвращает размер SVG до экранирования
+template <typename Render>
+size_t RenderString(json::Writer& writer, Render render) {
+    writer.StartString();
+    json::StringValueBuf svg_buffer(writer);
+    std::ostream svg(&svg_buffer);
+    render(svg);
+    writer.EndString();
+    return svg_buffer.Size();
+}
+
+template <typename Render>
+RenderedMap RenderToJson(Render render) {
+    RenderedMap map;
+    json::StringAppendBuf json_buffer(map.json);
+    std::ostream json_stream(&json_buffer);
+    {
+        json::Writer writer(json_stream, json::PrintMode::COMPACT);
+        map.svg_size = RenderString(writer, render);
     }
+    return map;
+}
+
+} // namespace
+
+void RequestHandler::SetMetrics(metrics::RequestMetrics* metrics) {
+    metrics_ = metrics;
+}
+
+void RequestHandler::Prepare() const {
+    GetRenderer();
+    GetRouter();
+}
 
 std::optional<domain::BusStat> RequestHandler::GetBusStat(const std::string_view& bus_name) const {
+    LatencyTimer timer(metrics_, RequestKind::BUS);
     if (const domain::Bus* bus = catalogue_.GetBus(bus_name); bus) {
         return catalogue_.GetRouteInformation(bus);
     }
+    RecordNotFound(RequestKind::BUS);
     return std::nullopt;
 }
 
 const std::set<std::string_view>* RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
+    LatencyTimer timer(metrics_, RequestKind::STOP);
     if (const domain::Stop* stop = catalogue_.GetStop(stop_name); stop) {
         return &catalogue_.GetBusesByStop(stop);
     }
+    RecordNotFound(RequestKind::STOP);
     return nullptr;
 }
 
-std::string RequestHandler::RenderMap() const {
-    std::ostringstream out;
-    renderer_.GetMap(out, catalogue_.GetAllValidStops(), catalogue_.GetAllBuses());
-    return out.str();
+const RenderedMap& RequestHandler::RenderMap() const {
+    const renderer::MapRenderer& map_renderer = GetRenderer();
+    LatencyTimer timer(metrics_, RequestKind::MAP);
+    bool rendered = false;
+    std::call_once(map_once_, [this, &map_renderer, &rendered] {
+        map_ = RenderToJson([this, &map_renderer](std::ostream& svg) {
+            map_renderer.GetMap(svg, catalogue_.GetAllValidStops(), catalogue_.GetAllBuses());
+        });
+        rendered = true;
+    });
+    if (metrics_) {
+        metrics_->RecordMapCache(!rendered);
+        metrics_->RecordSvgBytes(map_.svg_size);
+    }
+    return map_;
+}
+
+renderer::GeoBox RequestHandler::GetMapViewBox(const renderer::MapView& view) const {
+    GetRenderer();
+    const renderer::MapIndex& index = GetMapIndex();
+    return std::holds_alternative<renderer::Tile>(view)
+            ? index.GetTileBox(std::get<renderer::Tile>(view))
+            : std::get<renderer::GeoBox>(view);
+}
+
+size_t RequestHandler::RenderMapView(const renderer::GeoBox& box, json::Writer& writer) const {
+    const renderer::MapRenderer& map_renderer = GetRenderer();
+    const renderer::MapIndex& index = GetMapIndex();
+    LatencyTimer timer(metrics_, RequestKind::MAP);
+    const size_t svg_size = RenderString(writer, [&map_renderer, &index, &box](std::ostream& svg) {
+        map_renderer.GetMapView(svg, index, box);
+    });
+    if (metrics_) {
+        metrics_->RecordSvgBytes(svg_size);
+    }
+    return svg_size;
 }
 
 std::optional<domain::RouteInfo> RequestHandler::GetRoute(std::string_view from, std::string_view to) const {
-    return router_.BuildRoute(from, to);
+    const router::TransportRouter& transport_router = GetRouter();
+    LatencyTimer timer(metrics_, RequestKind::ROUTE);
+    auto route = transport_router.BuildRoute(from, to);
+    RecordRoute(route);
+    return route;
+}
+
+namespace {
+
+void CheckResultsSize(size_t query_count, size_t result_count) {
+    if (query_count != result_count) {
+        throw std::invalid_argument("results size mismatch"s);
+    }
+}
+
+} // namespace
+
+void RequestHandler::GetBusStats(ranges::Span<const std::string_view> bus_names,
+        ranges::Span<std::optional<domain::BusStat>> results) const {
+    CheckResultsSize(bus_names.size(), results.size());
+    // Статистика маршрута считается по всем его остановкам, поэтому для повторов
+    // одного автобуса берётся уже посчитанная
+    std::unordered_map<const domain::Bus*, size_t> first_result;
+    for (size_t i = 0; i < bus_names.size(); ++i) {
+        LatencyTimer timer(metrics_, RequestKind::BUS);
+        const domain::Bus* bus = catalogue_.GetBus(bus_names[i]);
+        if (!bus) {
+            results[i] = std::nullopt;
+            RecordNotFound(RequestKind::BUS);
+            continue;
+        }
+        if (const auto [it, inserted] = first_result.emplace(bus, i); !inserted) {
+            results[i] = results[it->second];
+        } else {
+            results[i] = catalogue_.GetRouteInformation(bus);
+        }
+    }
+}
+
+void RequestHandler::GetBusesByStops(ranges::Span<const std::string_view> stop_names,
+        ranges::Span<const std::set<std::string_view>*> results) const {
+    CheckResultsSize(stop_names.size(), results.size());
+    for (size_t i = 0; i < stop_names.size(); ++i) {
+        LatencyTimer timer(metrics_, RequestKind::STOP);
+        const domain::Stop* stop = catalogue_.GetStop(stop_names[i]);
+        results[i] = stop ? &catalogue_.GetBusesByStop(stop) : nullptr;
+        if (!stop) {
+            RecordNotFound(RequestKind::STOP);
+        }
+    }
+}
+
+void RequestHandler::GetRoutes(ranges::Span<const router::RouteQuery> queries,
+        ranges::Span<std::optional<domain::RouteInfo>> results) const {
+    CheckResultsSize(queries.size(), results.size());
+    if (queries.size() == 0) {
+        return;
+    }
+    const router::TransportRouter& transport_router = GetRouter();
+    if (!metrics_) {
+        transport_router.BuildRoutes(queries, results);
+        return;
+    }
+    // Маршруты строятся подряд, поэтому время запроса — промежуток
+    // от готовности предыдущего результата до готовности его собственного
+    auto last = std::chrono::steady_clock::now();
+    transport_router.BuildRoutes(queries, results, [this, &last](size_t) {
+        const auto now = std::chrono::steady_clock::now();
+        metrics_->RecordLatency(RequestKind::ROUTE, now - last);
+        last = now;
+    });
+    for (const auto& route : results) {
+        RecordRoute(route);
+    }
+}
+
+void RequestHandler::RecordRepeat(const RepeatedRequest& repeat,
+        std::chrono::steady_clock::duration elapsed) const {
+    if (!metrics_) {
+        return;
+    }
+    metrics_->RecordLatency(repeat.kind, elapsed);
+    if (!repeat.found) {
+        metrics_->RecordNotFound(repeat.kind);
+    } else if (repeat.kind == RequestKind::ROUTE) {
+        metrics_->RecordRouteEdges(repeat.route_edges);
+    } else if (repeat.kind == RequestKind::MAP) {
+        metrics_->RecordSvgBytes(repeat.svg_bytes);
+    }
+}
+
+void RequestHandler::RecordNotFound(metrics::RequestKind kind) const {
+    if (metrics_) {
+        metrics_->RecordNotFound(kind);
+    }
+}
+
+void RequestHandler::RecordRoute(const std::optional<domain::RouteInfo>& route) const {
+    if (!metrics_) {
+        return;
+    }
+    if (route) {
+        metrics_->RecordRouteEdges(CountRouteEdges(*route));
+    } else {
+        metrics_->RecordNotFound(RequestKind::ROUTE);
+    }
+}
+
+// Если настройка бросила исключение, построение повторится при следующем запросе
+const renderer::MapRenderer& RequestHandler::GetRenderer() const {
+    std::call_once(renderer_once_, [this] {
+        renderer::MapRenderer renderer;
+        setup_renderer_(renderer);
+        renderer_ = std::move(renderer);
+    });
+    return renderer_;
+}
+
+const renderer::MapIndex& RequestHandler::GetMapIndex() const {
+    std::call_once(map_index_once_, [this] {
+        map_index_.emplace(catalogue_.GetAllValidStops(), catalogue_.GetAllBuses());
+    });
+    return *map_index_;
+}
+
+const router::TransportRouter& RequestHandler::GetRouter() const {
+    std::call_once(router_once_, [this] {
+        setup_routing_(routing_settings_);
+        router_.emplace(catalogue_, routing_settings_);
+    });
+    return *router_;
 }
 
 }
@@ -1,34 +1,130 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <unordered_set>
 
 #include "transport_catalogue.h"
+#include "json_writer.h"
 #include "map_renderer.h"
+#include "map_index.h"
 #include "transport_router.h"
 #include "domain.h"
+#include "ranges.h"
+#include "metrics.h"
 
 namespace handler {
 
+// Карта в том виде, в каком она попадает в ответ. Справочник и настройки
+// отрисовки не меняются за время работы, поэтому полная карта строится один раз
+// и дальше только копируется в ответы
+struct RenderedMap {
+    // SVG в виде строкового значения JSON: в кавычках и с экранированием.
+    // Визуализатор выводит SVG сразу в этом виде, без промежуточной строки
+    std::string json;
+    // Размер SVG до экранирования
+    size_t svg_size = 0;
+};
+
+// Повтор запроса, ответ на который выдан из уже вычисленного без обращения
+// к обработчику. Описывает то, что обработчик учёл в метриках для исходного запроса
+struct RepeatedRequest {
+    metrics::RequestKind kind = metrics::RequestKind::BUS;
+    bool found = false;
+    // Число поездок найденного маршрута
+    std::uint64_t route_edges = 0;
+    // Размер SVG карты
+    std::uint64_t svg_bytes = 0;
+};
+
+// Число поездок маршрута: рёбер графа, по которым он проходит
+std::uint64_t CountRouteEdges(const domain::RouteInfo& route);
+
+/*
+ * Маршрутизатор (с предрасчётом всех маршрутов за O(V³)) и визуализатор строятся
+ * при первом запросе Route и Map соответственно: пакету только из Bus и Stop
+ * они не нужны. Настройки передаются функциями, которые вызываются при построении.
+ * Построение потокобезопасно, дальше все методы только читают
+ */
 class RequestHandler {
 public:
+    using RendererSetup = std::function<void(renderer::MapRenderer&)>;
+    using RoutingSetup = std::function<void(router::RoutingSettings&)>;
+
     RequestHandler(const catalogue::TransportCatalogue& catalogue,
-            const renderer::MapRenderer& renderer,
-            const router::TransportRouter& router);
+            RendererSetup setup_renderer, RoutingSetup setup_routing);
+
+    RequestHandler(const RequestHandler&) = delete;
+    RequestHandler& operator=(const RequestHandler&) = delete;
+
+    // Включает сбор метрик (nullptr — выключает). Метрики должны жить дольше
+    // обработчика; вызывать до начала обработки запросов
+    void SetMetrics(metrics::RequestMetrics* metrics);
+
+    // Строит визуализатор и маршрутизатор сразу, не дожидаясь запросов
+    void Prepare() const;
 
     std::optional<domain::BusStat> GetBusStat(const std::string_view& bus_name) const;
 
     const std::set<std::string_view>* GetBusesByStop(const std::string_view& stop_name) const;
 
-    std::string RenderMap() const;
+    // Первый вызов строит карту, остальные возвращают её же
+    const RenderedMap& RenderMap() const;
+
+    // Область части карты, заданной областью или тайлом. Визуализатор и индекс
+    // для поиска видимых остановок и участков маршрутов строятся при первом вызове
+    renderer::GeoBox GetMapViewBox(const renderer::MapView& view) const;
+
+    // Выводит часть карты в области box строковым значением JSON прямо в writer:
+    // она своя у каждого запроса, и хранить её до вывода незачем.
+    // Возвращает размер SVG до экранирования
+    size_t RenderMapView(const renderer::GeoBox& box, json::Writer& writer) const;
 
     std::optional<domain::RouteInfo> GetRoute(std::string_view from, std::string_view to) const;
 
+    // Пакетные варианты: ответ для i-го запроса записывается в results[i],
+    // размеры должны совпадать. Имена разрешаются один раз на пакет
+    void GetBusStats(ranges::Span<const std::string_view> bus_names,
+            ranges::Span<std::optional<domain::BusStat>> results) const;
+
+    void GetBusesByStops(ranges::Span<const std::string_view> stop_names,
+            ranges::Span<const std::set<std::string_view>*> results) const;
+
+    void GetRoutes(ranges::Span<const router::RouteQuery> queries,
+            ranges::Span<std::optional<domain::RouteInfo>> results) const;
+
+    // Учитывает в метриках повтор так же, как исходный запрос; elapsed — время,
+    // за которое выдан повтор
+    void RecordRepeat(const RepeatedRequest& repeat,
+            std::chrono::steady_clock::duration elapsed) const;
+
 private:
     const catalogue::TransportCatalogue& catalogue_;
-    const renderer::MapRenderer& renderer_;
-    const router::TransportRouter& router_;
+    RendererSetup setup_renderer_;
+    RoutingSetup setup_routing_;
+
+    mutable std::once_flag renderer_once_;
+    mutable renderer::MapRenderer renderer_;
+    mutable std::once_flag router_once_;
+    mutable router::RoutingSettings routing_settings_{};
+    mutable std::optional<router::TransportRouter> router_;
+    mutable std::once_flag map_once_;
+    mutable RenderedMap map_;
+    mutable std::once_flag map_index_once_;
+    mutable std::optional<renderer::MapIndex> map_index_;
+
+    metrics::RequestMetrics* metrics_ = nullptr;
+
+    const renderer::MapRenderer& GetRenderer() const;
+    const router::TransportRouter& GetRouter() const;
+    const renderer::MapIndex& GetMapIndex() const;
+    void RecordNotFound(metrics::RequestKind kind) const;
+    void RecordRoute(const std::optional<domain::RouteInfo>& route) const;
 };
 
 } // end namespace
@@ -0,0 +1,316 @@
+#include "socket_server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "json_reader.h"
+#include "json_writer.h"
+
+namespace server {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+// Строка длиннее этого предела считается ошибкой клиента, соединение закрывается
+constexpr size_t MAX_LINE_SIZE = 16 * 1024 * 1024;
+// Готовые ответы отправляются, как только их наберётся столько байт,
+// не дожидаясь конца блока строк: ответы на запросы Map занимают мегабайты
+constexpr size_t SEND_SIZE = 64 * 1024;
+// Клиент, который столько секунд не читает ответы, отключается. Иначе поток
+// соединения навсегда блокируется в send, и остановка сервера ждёт его.
+// Первый send по таймауту возвращает частично отправленное, второй — ошибку,
+// поэтому соединение закрывается не позже чем через два таймаута
+constexpr time_t SEND_TIMEOUT_SEC = 5;
+
+// Обработчик сигнала может только записать байт команды в канал
+volatile std::sig_atomic_t command_signal_fd = -1;
+
+// Команды, передаваемые через канал в цикл приёма соединений
+constexpr char STOP_COMMAND = 's';
+constexpr char DUMP_COMMAND = 'd';
+
+void HandleSignal(int signal) {
+    const int saved_errno = errno;
+    const char command = signal == SIGUSR1 ? DUMP_COMMAND : STOP_COMMAND;
+    [[maybe_unused]] auto result = write(command_signal_fd, &command, 1);
+    errno = saved_errno;
+}
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+bool SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+} // namespace
+
+SocketServer::SocketServer(const handler::RequestHandler& handler, std::string socket_path)
+    : handler_(handler)
+    , socket_path_(std::move(socket_path)) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path_.empty() || socket_path_.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Invalid socket path: "s + socket_path_);
+    }
+    socket_path_.copy(address.sun_path, socket_path_.size());
+
+    if (pipe2(command_pipe_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        ThrowSystemError("pipe2");
+    }
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        ThrowSystemError("socket");
+    }
+    // Сокет, оставшийся от предыдущего запуска, заменяется; другие файлы не трогаем
+    struct stat path_stat{};
+    if (stat(socket_path_.c_str(), &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+        unlink(socket_path_.c_str());
+    }
+    if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        ThrowSystemError("bind");
+    }
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        ThrowSystemError("listen");
+    }
+}
+
+SocketServer::~SocketServer() {
+    ShutdownConnections();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+    }
+    for (int fd : command_pipe_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void SocketServer::Run() {
+    command_signal_fd = command_pipe_[1];
+    struct sigaction action{};
+    action.sa_handler = HandleSignal;
+    sigemptyset(&action.sa_mask);
+    struct sigaction old_int{}, old_term{}, old_usr1{};
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+    if (on_dump_) {
+        sigaction(SIGUSR1, &action, &old_usr1);
+    }
+
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {command_pipe_[0], POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("poll");
+        }
+        if (fds[1].revents != 0 && ReadCommands()) {
+            break;
+        }
+        if ((fds[0].revents & POLLIN) == 0) {
+            continue;
+        }
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+                std::cerr << "accept: "sv << std::strerror(errno) << '\n';
+            }
+            continue;
+        }
+        const timeval send_timeout{SEND_TIMEOUT_SEC, 0};
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout)) < 0) {
+            std::cerr << "setsockopt: "sv << std::strerror(errno) << '\n';
+        }
+        ReapFinished();
+        std::lock_guard guard(connections_mutex_);
+        Connection& connection = connections_.emplace_back();
+        connection.fd = fd;
+        connection.thread = std::thread(&SocketServer::Serve, this, std::ref(connection));
+    }
+
+    sigaction(SIGINT, &old_int, nullptr);
+    sigaction(SIGTERM, &old_term, nullptr);
+    if (on_dump_) {
+        sigaction(SIGUSR1, &old_usr1, nullptr);
+    }
+    command_signal_fd = -1;
+
+    // Новые клиенты больше не принимаются
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(socket_path_.c_str());
+    ShutdownConnections();
+}
+
+void SocketServer::Stop() {
+    [[maybe_unused]] auto result = write(command_pipe_[1], &STOP_COMMAND, 1);
+}
+
+void SocketServer::SetDumpHandler(std::function<void()> on_dump) {
+    on_dump_ = std::move(on_dump);
+}
+
+bool SocketServer::ReadCommands() {
+    bool stop = false;
+    char commands[64];
+    ssize_t count = 0;
+    while ((count = read(command_pipe_[0], commands, sizeof(commands))) > 0) {
+        for (ssize_t i = 0; i < count; ++i) {
+            if (commands[i] == DUMP_COMMAND) {
+                if (on_dump_) {
+                    on_dump_();
+                }
+            } else {
+                stop = true;
+            }
+        }
+    }
+    return stop;
+}
+
+void SocketServer::Serve(Connection& connection) const {
+    std::string input;
+    // Ответы выводятся прямо в строку, и отправляется её начало без копирования
+    std::string output;
+    json::StringAppendBuf output_buffer(output);
+    std::ostream output_stream(&output_buffer);
+    json::Writer writer(output_stream, json::PrintMode::COMPACT);
+    char chunk[READ_CHUNK_SIZE];
+
+    // Размер начала вывода, занятого полностью выведенными ответами. Большой ответ
+    // сбрасывается из writer по частям, и при ошибке его начало не отправляется
+    size_t complete_size = 0;
+
+    auto send_output = [&connection, &output, &complete_size] {
+        const bool sent = SendAll(connection.fd, std::string_view(output).substr(0, complete_size));
+        output.erase(0, complete_size);
+        complete_size = 0;
+        // Память после большого ответа не держится, пока соединение простаивает
+        if (output.empty() && output.capacity() > SEND_SIZE) {
+            output.shrink_to_fit();
+        }
+        return sent;
+    };
+    // Возвращает false, если клиенту не удалось отправить ответы
+    auto end_line = [&writer, &output, &complete_size, &send_output] {
+        writer.Flush();
+        output.push_back('\n');
+        complete_size = output.size();
+        return complete_size < SEND_SIZE || send_output();
+    };
+    // Ошибки отдельных запросов ProcessRequestLine выводит как ответы на них
+    auto process_line = [this, &writer, &end_line](std::string_view line) {
+        return !json_reader::ProcessRequestLine(handler_, line, writer) || end_line();
+    };
+
+    try {
+        while (true) {
+            const ssize_t received = recv(connection.fd, chunk, sizeof(chunk), 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                // Клиент закончил передачу или сервер останавливается:
+                // последняя строка может быть без перевода строки
+                if (process_line(input)) {
+                    send_output();
+                }
+                break;
+            }
+            input.append(chunk, static_cast<size_t>(received));
+
+            bool connected = true;
+            size_t line_begin = 0;
+            for (size_t line_end = input.find('\n'); connected && line_end != std::string::npos;
+                    line_end = input.find('\n', line_begin)) {
+                connected = process_line(
+                        std::string_view(input).substr(line_begin, line_end - line_begin));
+                line_begin = line_end + 1;
+            }
+            input.erase(0, line_begin);
+
+            if (connected && input.size() > MAX_LINE_SIZE) {
+                writer.StartDict()
+                        .Key("error_message"sv).Value("request line is too long"sv)
+                        .EndDict();
+                end_line();
+                send_output();
+                break;
+            }
+            // Ответы на остаток блока отправляются вместе
+            if (!connected || !send_output()) {
+                break;
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << "connection: "sv << error.what() << '\n';
+        // Ответы, готовые до ошибки, доходят до клиента перед закрытием соединения
+        send_output();
+    }
+    // Клиент получает конец потока сразу; дескриптор закрывается при сборе соединений,
+    // чтобы его номер не переиспользовался, пока соединение остаётся в списке
+    shutdown(connection.fd, SHUT_RDWR);
+    connection.finished = true;
+}
+
+void SocketServer::ReapFinished() {
+    std::lock_guard guard(connections_mutex_);
+    for (auto it = connections_.begin(); it != connections_.end();) {
+        if (it->finished) {
+            it->thread.join();
+            close(it->fd);
+            it = connections_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SocketServer::ShutdownConnections() {
+    std::list<Connection> connections;
+    {
+        std::lock_guard guard(connections_mutex_);
+        // Чтение прерывается, но уже принятые запросы обрабатываются и отправляются.
+        // Отправка клиенту, который не читает ответы, прерывается по SEND_TIMEOUT_SEC
+        for (Connection& connection : connections_) {
+            shutdown(connection.fd, SHUT_RD);
+        }
+        connections.splice(connections.end(), connections_);
+    }
+    for (Connection& connection : connections) {
+        connection.thread.join();
+        close(connection.fd);
+    }
+}
+
+} // end namespace server
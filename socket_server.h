@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "request_handler.h"
+
+namespace server {
+
+/*
+ * Долгоживущий режим: справочник, визуализатор и маршрутизатор строятся один раз,
+ * а запросы принимаются по локальному Unix-сокету. Протокол совпадает с режимом
+ * NDJSON: клиент пишет запросы из "stat_requests" по одному JSON-объекту на строку
+ * и получает ответы по одному на строку в том же порядке. Клиент может отправлять
+ * запросы, не дожидаясь ответов на предыдущие: все полученные целиком строки
+ * обрабатываются подряд, а ответы на них уходят одной записью.
+ * Каждое соединение обслуживается в своём потоке; RequestHandler используется
+ * только через константные методы
+ */
+class SocketServer {
+public:
+    SocketServer(const handler::RequestHandler& handler, std::string socket_path);
+
+    SocketServer(const SocketServer&) = delete;
+    SocketServer& operator=(const SocketServer&) = delete;
+
+    ~SocketServer();
+
+    // Принимает соединения до вызова Stop или сигнала SIGINT/SIGTERM.
+    // При остановке новые соединения не принимаются, клиенты получают ответы
+    // на уже присланные запросы, после чего сокет удаляется
+    void Run();
+
+    // Можно вызывать из любого потока и из обработчика сигнала
+    void Stop();
+
+    // Вызывается в цикле приёма соединений по сигналу SIGUSR1;
+    // задаётся до Run
+    void SetDumpHandler(std::function<void()> on_dump);
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::thread thread;
+        std::atomic<bool> finished = false;
+    };
+
+    const handler::RequestHandler& handler_;
+    std::string socket_path_;
+    int listen_fd_ = -1;
+    int command_pipe_[2] = {-1, -1};
+    std::mutex connections_mutex_;
+    std::list<Connection> connections_;
+    std::function<void()> on_dump_;
+
+    void Serve(Connection& connection) const;
+    // Читает команды из канала; возвращает true, если пришла команда остановки
+    bool ReadCommands();
+    void ReapFinished();
+    void ShutdownConnections();
+};
+
+} // end namespace server
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace concurrent {
+
+/*
+ * Ограниченная очередь без блокировок для одного производителя и одного потребителя.
+ * Кольцевой буфер фиксированного размера (степень двойки); индексы головы и хвоста
+ * растут монотонно и лежат в разных кэш-линиях. Если очередь пуста или заполнена,
+ * поток недолго ждёт, уступая процессор, а затем засыпает на условной переменной.
+ * Мьютекс захватывается только при засыпании и при пробуждении спящей стороны
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : slots_(RoundUpToPowerOfTwo(capacity))
+        , mask_(slots_.size() - 1) {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Вызывается только производителем. Возвращает false, если очередь закрыта
+    bool Push(T value) {
+        if (closed_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const auto ready = [this, tail] {
+            return tail - head_.load(std::memory_order_acquire) != slots_.size()
+                    || closed_.load(std::memory_order_acquire);
+        };
+        if (!ready()) {
+            Wait(producer_waiting_, not_full_, ready);
+            // Очередь закрыли, пока производитель ждал места
+            if (closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        Wake(consumer_waiting_, not_empty_);
+        return true;
+    }
+
+    // Вызывается только потребителем. Возвращает false, когда очередь закрыта и пуста
+    bool Pop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const auto ready = [this, head] {
+            return head != tail_.load(std::memory_order_acquire)
+                    || closed_.load(std::memory_order_acquire);
+        };
+        if (!ready()) {
+            Wait(consumer_waiting_, not_empty_, ready);
+        }
+        // Элемент мог быть добавлен перед закрытием
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        Wake(producer_waiting_, not_full_);
+        return true;
+    }
+
+    // Производитель закрывает очередь после последнего элемента;
+    // потребитель — чтобы остановить производителя при ошибке
+    void Close() {
+        closed_.store(true, std::memory_order_release);
+        std::lock_guard guard(mutex_);
+        not_empty_.notify_one();
+        not_full_.notify_one();
+    }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    // Сколько раз поток уступает процессор, прежде чем заснуть
+    static constexpr int SPIN_COUNT = 64;
+
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> closed_ = false;
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> producer_waiting_ = false;
+    std::atomic<bool> consumer_waiting_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+
+    // Флаг ожидания и индекс разделены барьерами: либо будящая сторона видит флаг,
+    // либо ждущая — уже изменённый индекс, и пробуждение не теряется
+    template <typename Ready>
+    void Wait(std::atomic<bool>& waiting, std::condition_variable& condition, Ready ready) {
+        for (int i = 0; i < SPIN_COUNT; ++i) {
+            std::this_thread::yield();
+            if (ready()) {
+                return;
+            }
+        }
+        std::unique_lock lock(mutex_);
+        waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait(lock, ready);
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    void Wake(std::atomic<bool>& waiting, std::condition_variable& condition) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard guard(mutex_);
+            condition.notify_one();
+        }
+    }
+
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+};
+
+} // end namespace concurrent
@@ -1,9 +1,102 @@
 #include "svg.h"
 
+#include <charconv>
+#include <cmath>
+
 namespace svg {
 
 using namespace std::literals;
 
+namespace {
+
+constexpr std::array<std::uint64_t, MAX_PRECISION + 1> POWERS_OF_TEN = [] {
+    std::array<std::uint64_t, MAX_PRECISION + 1> powers{};
+    std::uint64_t power = 1;
+    for (auto& value : powers) {
+        value = power;
+        power *= 10;
+    }
+    return powers;
+}();
+
+// Граница, до которой округлённое масштабированное число точно представимо в double
+constexpr double MAX_SCALED = 1e15;
+
+// Целые и дробные цифры выводятся целочисленной арифметикой: это в разы
+// быстрее to_chars с фиксированной точностью. Половины округляются от нуля
+std::optional<std::string_view> FormatFixed(double value, int precision, NumberChars& chars) {
+    const double scaled = value * static_cast<double>(POWERS_OF_TEN[precision]);
+    if (!(std::abs(scaled) < MAX_SCALED)) {
+        return std::nullopt;
+    }
+    const long long rounded = std::llround(scaled);
+    std::uint64_t magnitude = rounded < 0 ? -rounded : rounded;
+    int decimals = precision;
+    while (decimals > 0 && magnitude % 10 == 0) {
+        magnitude /= 10;
+        --decimals;
+    }
+
+    char* const begin = chars.data();
+    char* out = begin;
+    if (rounded < 0) {
+        *out++ = '-';
+    }
+    const std::uint64_t scale = POWERS_OF_TEN[decimals];
+    out = std::to_chars(out, begin + chars.size(), magnitude / scale).ptr;
+    if (decimals > 0) {
+        *out++ = '.';
+        std::uint64_t fraction = magnitude % scale;
+        for (int i = decimals - 1; i >= 0; --i) {
+            out[i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        out += decimals;
+    }
+    return std::string_view(begin, out - begin);
+}
+
+// Медленный путь для чисел, которые не помещаются в FormatFixed
+std::optional<std::string_view> FormatFixedLong(double value, int precision, NumberChars& chars) {
+    char* const begin = chars.data();
+    const auto result = std::to_chars(begin, begin + chars.size(), value,
+            std::chars_format::fixed, precision);
+    if (result.ec != std::errc{}) {
+        return std::nullopt;
+    }
+    std::string_view number(begin, result.ptr - begin);
+    if (number.find('.') != std::string_view::npos) {
+        number.remove_suffix(number.size() - number.find_last_not_of('0') - 1);
+        if (number.back() == '.') {
+            number.remove_suffix(1);
+        }
+    }
+    return number == "-0"sv ? "0"sv : number;
+}
+
+} // namespace
+
+std::string_view FormatNumber(double value, Precision precision, NumberChars& chars) {
+    if (precision) {
+        if (const auto fixed = FormatFixed(value, *precision, chars)) {
+            return *fixed;
+        }
+        if (const auto fixed = FormatFixedLong(value, *precision, chars)) {
+            return *fixed;
+        }
+    }
+    // Формат совпадает с выводом double в std::ostream по умолчанию (%g, 6 знаков).
+    // Так же выводятся числа, которые с точностью не помещаются в буфер
+    const auto result = std::to_chars(chars.data(), chars.data() + chars.size(), value,
+            std::chars_format::general, 6);
+    return std::string_view(chars.data(), result.ptr - chars.data());
+}
+
+void WriteNumber(std::ostream& out, double value, Precision precision) {
+    NumberChars chars;
+    out << FormatNumber(value, precision, chars);
+}
+
 void Object::Render(const RenderContext& context) const {
     context.RenderIndent();
 
@@ -69,7 +162,8 @@ void OstreamColorPrinter::operator()(Rgba rgba_color) const {
     out << static_cast<int>(rgba_color.red) << ","s;
     out << static_cast<int>(rgba_color.green) << ","s;
     out << static_cast<int>(rgba_color.blue) << ","s;
-    out << rgba_color.opacity << ")"s;
+    WriteNumber(out, rgba_color.opacity, precision);
+    out << ")"s;
 }
 
 // ---------- Circle ------------------
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <variant>
@@ -34,6 +36,20 @@ enum class StrokeLineJoin {
     ROUND,
 };
 
+// Число знаков после запятой при выводе чисел. Без значения числа выводятся
+// так же, как std::ostream по умолчанию: не более 6 значащих цифр
+using Precision = std::optional<int>;
+
+inline constexpr int MAX_PRECISION = 15;
+
+using NumberChars = std::array<char, 64>;
+
+// Форматирует число без std::ostream. С заданной точностью незначащие нули
+// дробной части отбрасываются. Результат ссылается на chars
+std::string_view FormatNumber(double value, Precision precision, NumberChars& chars);
+
+void WriteNumber(std::ostream& out, double value, Precision precision = std::nullopt);
+
 std::ostream& operator<<(std::ostream& out, const StrokeLineCap& line_cap);
 std::ostream& operator<<(std::ostream& out, const StrokeLineJoin& line_join);
 
@@ -116,6 +132,7 @@ inline const std::string NoneColor{"none"};
 
 struct OstreamColorPrinter {
     std::ostream& out;
+    Precision precision;
 
     void operator()(std::monostate) const;
     void operator()(std::string color) const;
@@ -135,7 +152,9 @@ public:
 protected:
     ~PathProps() = default;
 
-    void RenderAttrs(std::ostream& out) const;
+    void RenderAttrs(std::ostream& out, Precision precision = std::nullopt) const;
+    // Те же свойства в виде объявлений CSS: "fill:...;stroke:..."
+    void RenderCss(std::ostream& out, Precision precision = std::nullopt) const;
 
 private:
     Owner& AsOwner();
@@ -179,21 +198,23 @@ Owner& PathProps<Owner>::SetStrokeLineJoin(StrokeLineJoin line_join) {
 }
 
 template <typename Owner>
-void PathProps<Owner>::RenderAttrs(std::ostream& out) const {
+void PathProps<Owner>::RenderAttrs(std::ostream& out, Precision precision) const {
     using namespace std::literals;
 
     if (fill_color_) {
         out << " fill=\""sv;
-        std::visit(OstreamColorPrinter{out}, *fill_color_);
+        std::visit(OstreamColorPrinter{out, precision}, *fill_color_);
         out << "\""sv;
     }
     if (stroke_color_) {
         out << " stroke=\""sv;
-        std::visit(OstreamColorPrinter{out}, *stroke_color_);
+        std::visit(OstreamColorPrinter{out, precision}, *stroke_color_);
         out << "\""sv;
     }
     if (stroke_width_) {
-        out << " stroke-width=\""sv << *stroke_width_ << "\""sv;
+        out << " stroke-width=\""sv;
+        WriteNumber(out, *stroke_width_, precision);
+        out << "\""sv;
     }
     if (stroke_line_cap_) {
         out << " stroke-linecap=\""sv << *stroke_line_cap_ << "\""sv;
@@ -203,6 +224,38 @@ void PathProps<Owner>::RenderAttrs(std::ostream& out) const {
     }
 }
 
+template <typename Owner>
+void PathProps<Owner>::RenderCss(std::ostream& out, Precision precision) const {
+    using namespace std::literals;
+
+    bool is_first = true;
+    auto property = [&out, &is_first](std::string_view name) -> std::ostream& {
+        if (!is_first) {
+            out << ';';
+        }
+        is_first = false;
+        return out << name << ':';
+    };
+    if (fill_color_) {
+        std::visit(OstreamColorPrinter{property("fill"sv), precision}, *fill_color_);
+    }
+    if (stroke_color_) {
+        std::visit(OstreamColorPrinter{property("stroke"sv), precision}, *stroke_color_);
+    }
+    if (stroke_width_) {
+        // В CSS длина без единиц измерения допустима не везде, а px совпадает
+        // с единицами пользователя SVG
+        WriteNumber(property("stroke-width"sv), *stroke_width_, precision);
+        out << "px"sv;
+    }
+    if (stroke_line_cap_) {
+        property("stroke-linecap"sv) << *stroke_line_cap_;
+    }
+    if (stroke_line_join_) {
+        property("stroke-linejoin"sv) << *stroke_line_join_;
+    }
+}
+
 template <typename Owner>
 Owner& PathProps<Owner>::AsOwner() {
     // static_cast безопасно преобразует *this к Owner&,
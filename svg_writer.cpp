@@ -0,0 +1,190 @@
+#include "svg_writer.h"
+
+#include <sstream>
+
+namespace svg {
+
+using namespace std::literals;
+
+std::string Style::Render(Precision precision) const {
+    std::ostringstream out;
+    RenderAttrs(out, precision);
+    return out.str();
+}
+
+std::string Style::RenderCss(Precision precision) const {
+    std::ostringstream out;
+    PathProps::RenderCss(out, precision);
+    return out.str();
+}
+
+std::string RenderOffsetAttrs(Point offset, Precision precision) {
+    std::ostringstream out;
+    out << " dx=\""sv;
+    WriteNumber(out, offset.x, precision);
+    out << "\" dy=\""sv;
+    WriteNumber(out, offset.y, precision);
+    out << "\""sv;
+    return out.str();
+}
+
+std::string RenderFontAttrs(Point offset, uint32_t font_size,
+        std::string_view font_family, std::string_view font_weight, Precision precision) {
+    std::ostringstream out;
+    out << RenderOffsetAttrs(offset, precision);
+    out << " font-size=\""sv << font_size << "\""sv;
+    if (!font_family.empty()) {
+        out << " font-family=\""sv << font_family << "\""sv;
+    }
+    if (!font_weight.empty()) {
+        out << " font-weight=\""sv << font_weight << "\""sv;
+    }
+    return out.str();
+}
+
+std::string RenderFontCss(uint32_t font_size, std::string_view font_family,
+        std::string_view font_weight) {
+    std::ostringstream out;
+    if (!font_family.empty()) {
+        out << "font-family:"sv << font_family << ';';
+    }
+    // Размер шрифта в CSS без единиц измерения недопустим
+    out << "font-size:"sv << font_size << "px"sv;
+    if (!font_weight.empty()) {
+        out << ";font-weight:"sv << font_weight;
+    }
+    return out.str();
+}
+
+std::string RenderClassAttr(std::string_view classes) {
+    std::string attr = " class=\""s;
+    attr += classes;
+    attr += '"';
+    return attr;
+}
+
+Writer::Writer(std::ostream& output, Precision precision, size_t buffer_size)
+    : output_(output)
+    , buffer_size_(buffer_size)
+    , precision_(precision) {
+    buffer_.reserve(buffer_size_);
+}
+
+Writer::~Writer() {
+    Flush();
+}
+
+Writer& Writer::StartDocument() {
+    Write("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv);
+    Write("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv);
+    return *this;
+}
+
+Writer& Writer::EndDocument() {
+    Write("</svg>"sv);
+    return *this;
+}
+
+Writer& Writer::StyleSheet(std::string_view css) {
+    StartElement();
+    Write("<style>"sv);
+    Write(css);
+    Write("</style>\n"sv);
+    return *this;
+}
+
+Writer& Writer::Circle(Point center, double radius, std::string_view attrs) {
+    StartElement();
+    Write("<circle cx=\""sv);
+    WriteNumber(center.x);
+    Write("\" cy=\""sv);
+    WriteNumber(center.y);
+    Write("\" r=\""sv);
+    WriteNumber(radius);
+    Write('"');
+    Write(attrs);
+    Write("/>\n"sv);
+    return *this;
+}
+
+Writer& Writer::StartPolyline() {
+    StartElement();
+    Write("<polyline points=\""sv);
+    is_first_point_ = true;
+    return *this;
+}
+
+Writer& Writer::AddPoint(Point point) {
+    if (!is_first_point_) {
+        Write(' ');
+    }
+    is_first_point_ = false;
+    WriteNumber(point.x);
+    Write(',');
+    WriteNumber(point.y);
+    return *this;
+}
+
+Writer& Writer::EndPolyline(std::string_view attrs) {
+    Write('"');
+    Write(attrs);
+    Write("/>\n"sv);
+    return *this;
+}
+
+Writer& Writer::Text(std::string_view attrs, Point position, std::string_view font_attrs,
+        std::string_view data) {
+    StartElement();
+    Write("<text"sv);
+    Write(attrs);
+    Write(" x=\""sv);
+    WriteNumber(position.x);
+    Write("\" y=\""sv);
+    WriteNumber(position.y);
+    Write('"');
+    Write(font_attrs);
+    Write('>');
+    Write(data);
+    Write("</text>\n"sv);
+    return *this;
+}
+
+Writer& Writer::Fragment(std::string_view svg) {
+    Write(svg);
+    return *this;
+}
+
+void Writer::Flush() {
+    output_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+// Элементы документа выводятся с отступом в два пробела
+void Writer::StartElement() {
+    Write("  "sv);
+}
+
+void Writer::WriteNumber(double value) {
+    NumberChars chars;
+    Write(FormatNumber(value, precision_, chars));
+}
+
+void Writer::Write(std::string_view data) {
+    if (buffer_.size() + data.size() > buffer_size_) {
+        Flush();
+        if (data.size() >= buffer_size_) {
+            output_.write(data.data(), data.size());
+            return;
+        }
+    }
+    buffer_.append(data);
+}
+
+void Writer::Write(char c) {
+    if (buffer_.size() == buffer_size_) {
+        Flush();
+    }
+    buffer_.push_back(c);
+}
+
+}  // namespace svg
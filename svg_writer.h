@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "svg.h"
+
+namespace svg {
+
+/*
+ * Набор свойств PathProps без элемента. У многих элементов карты оформление
+ * одинаковое, поэтому атрибуты выводятся в строку один раз и дальше копируются
+ */
+class Style final : public PathProps<Style> {
+public:
+    // Атрибуты в том виде и порядке, в каком их выводят Circle, Polyline и Text
+    std::string Render(Precision precision = std::nullopt) const;
+
+    // Объявления CSS для правила класса: "fill:...;stroke:..."
+    std::string RenderCss(Precision precision = std::nullopt) const;
+};
+
+// Атрибуты шрифта <text>, которые идут после координат: dx, dy, font-size,
+// font-family, font-weight. Пустые семейство и толщина не выводятся
+std::string RenderFontAttrs(Point offset, uint32_t font_size,
+        std::string_view font_family = {}, std::string_view font_weight = {},
+        Precision precision = std::nullopt);
+
+// Смещение <text> без свойств шрифта: для элементов, которым шрифт задаёт класс CSS
+std::string RenderOffsetAttrs(Point offset, Precision precision = std::nullopt);
+
+// Объявления CSS шрифта: font-family, font-size, font-weight
+std::string RenderFontCss(uint32_t font_size, std::string_view font_family = {},
+        std::string_view font_weight = {});
+
+// Атрибут class="..." со списком классов через пробел
+std::string RenderClassAttr(std::string_view classes);
+
+/*
+ * Потоковый вывод SVG без построения объектов: элементы сразу форматируются
+ * в буфер заданного размера, который сбрасывается в поток крупными блоками.
+ * Без точности вывод совпадает с svg::Document::Render для тех же элементов
+ * в том же порядке; с точностью числа выводятся с заданным числом знаков после запятой
+ */
+class Writer {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    explicit Writer(std::ostream& output, Precision precision = std::nullopt,
+            size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer();
+
+    Writer& StartDocument();
+    Writer& EndDocument();
+
+    // Элемент <style> с готовыми правилами CSS
+    Writer& StyleSheet(std::string_view css);
+
+    // attrs — результат Style::Render
+    Writer& Circle(Point center, double radius, std::string_view attrs);
+
+    // Вершины ломаной выводятся по одной между StartPolyline и EndPolyline
+    Writer& StartPolyline();
+    Writer& AddPoint(Point point);
+    Writer& EndPolyline(std::string_view attrs);
+
+    // font_attrs — результат RenderFontAttrs
+    Writer& Text(std::string_view attrs, Point position, std::string_view font_attrs,
+            std::string_view data);
+
+    // Готовая часть документа, выведенная другим Writer
+    Writer& Fragment(std::string_view svg);
+
+    // Сбрасывает накопленные данные в поток
+    void Flush();
+
+private:
+    std::ostream& output_;
+    std::string buffer_;
+    size_t buffer_size_;
+    Precision precision_;
+    bool is_first_point_ = true;
+
+    void StartElement();
+    void WriteNumber(double value);
+    void Write(std::string_view data);
+    void Write(char c);
+};
+
+}  // namespace svg
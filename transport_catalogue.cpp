@@ -12,6 +12,7 @@ using domain::Stop;
 
 void TransportCatalogue::AddStop(const Stop& stop) {
     stops_.push_back(std::move(stop));
+    stops_.back().id = stops_.size() - 1;
     stops_names_.emplace(stops_.back().name, &stops_.back());
 }
 
@@ -75,11 +76,11 @@ const domain::BusStat TransportCatalogue::GetRouteInformation(const Bus* bus) co
 }
 
 const std::set<std::string_view>& TransportCatalogue::GetBusesByStop(const Stop* stop) const {
-    static const std::set<std::string_view> null_buses;
-    if (buses_by_stop_.count(stop) == 0) {
-        return null_buses;
+    const auto it = buses_by_stop_.find(stop);
+    if (it == buses_by_stop_.end()) {
+        return empty_buses_;
     }
-    return buses_by_stop_.at(stop);
+    return it->second;
 }
 
 std::vector<const Stop*> TransportCatalogue::GetAllValidStops() const {
@@ -49,6 +49,9 @@ private:
     std::unordered_map<std::string_view, const Bus*> buses_names_;
     std::unordered_map<const Stop*, std::set<std::string_view>> buses_by_stop_;
     std::unordered_map<std::pair<const Stop*, const Stop*>, int, PairStopHasher> distance_;
+    // Ответ для остановок без маршрутов; член класса, а не локальная статическая
+    // переменная, чтобы константные методы не имели общего состояния между потоками
+    const std::set<std::string_view> empty_buses_;
 };
 
 } //end namespace catalogue
@@ -1,6 +1,10 @@
 #include "transport_router.h"
 
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+
+#include "profiler.h"
 
 
 namespace router {
@@ -18,7 +22,7 @@ TransportRouter::TransportRouter(const catalogue::TransportCatalogue& catalogue,
     , stop_vertex_id_()
     , edge_id_route_info_()
     , graph_(CreateGraph())
-    , router_(graph_) {
+    , router_(BuildRouter(graph_)) {
 }
 
 double TransportRouter::GetTripTimeFromGraph(size_t edge_id) const {
@@ -44,8 +48,12 @@ std::vector<domain::RouteItem> TransportRouter::CreateRouteItems(const std::vect
  
 std::optional<domain::RouteInfo> TransportRouter::BuildRoute(
         std::string_view from, std::string_view to) const {
-    const auto& route_opt =
-            router_.BuildRoute(stop_vertex_id_.at(from), stop_vertex_id_.at(to));
+    const auto vertex_from = FindGraphVertexId(from);
+    const auto vertex_to = FindGraphVertexId(to);
+    if (!vertex_from || !vertex_to) {
+        return std::nullopt;
+    }
+    const auto& route_opt = router_.BuildRoute(*vertex_from, *vertex_to);
     if (!route_opt) {
         return std::nullopt;
     }
@@ -53,6 +61,49 @@ std::optional<domain::RouteInfo> TransportRouter::BuildRoute(
 }
  
 
+void TransportRouter::BuildRoutes(ranges::Span<const RouteQuery> queries,
+        ranges::Span<std::optional<domain::RouteInfo>> results,
+        const std::function<void(size_t)>& on_result) const {
+    if (queries.size() != results.size()) {
+        throw std::invalid_argument("BuildRoutes: results size mismatch"s);
+    }
+    struct VertexQuery {
+        size_t from;
+        size_t to;
+        size_t index;
+    };
+    std::vector<VertexQuery> vertex_queries;
+    vertex_queries.reserve(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto vertex_from = FindGraphVertexId(queries[i].from);
+        const auto vertex_to = FindGraphVertexId(queries[i].to);
+        if (!vertex_from || !vertex_to) {
+            results[i] = std::nullopt;
+            if (on_result) {
+                on_result(i);
+            }
+            continue;
+        }
+        vertex_queries.push_back({*vertex_from, *vertex_to, i});
+    }
+    std::sort(vertex_queries.begin(), vertex_queries.end(),
+            [](const VertexQuery& lhs, const VertexQuery& rhs) {
+                return lhs.from < rhs.from;
+            });
+    for (const VertexQuery& query : vertex_queries) {
+        const auto& route_opt = router_.BuildRoute(query.from, query.to);
+        if (route_opt) {
+            results[query.index] = domain::RouteInfo{route_opt->weight,
+                    CreateRouteItems(route_opt->edges)};
+        } else {
+            results[query.index] = std::nullopt;
+        }
+        if (on_result) {
+            on_result(query.index);
+        }
+    }
+}
+
 void TransportRouter::FillGraphWithStops() {
     size_t count = 0;
     for (const Stop& stop : catalogue_.GetAllStops()) {
@@ -64,6 +115,14 @@ size_t TransportRouter::GetGraphVertexId (std::string_view name) const {
     return stop_vertex_id_.at(name);
 }
 
+std::optional<size_t> TransportRouter::FindGraphVertexId(std::string_view name) const {
+    const auto it = stop_vertex_id_.find(name);
+    if (it == stop_vertex_id_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
 double TransportRouter::ComputeTime(const Stop* from, const Stop* to) const {
     return catalogue_.GetDistance(from, to) / routing_settings_.bus_velocity;
 }
@@ -112,11 +171,18 @@ void TransportRouter::FillGraphWithRoutes(Graph& graph) {
 }
 
 Graph TransportRouter::CreateGraph() {
+    profiler::ScopedPhase phase("create_graph"sv);
     Graph graph(catalogue_.GetAllStopsSize());
     FillGraphWithStops();
     FillGraphWithRoutes(graph);
     return graph;
 }
 
+// Предрасчёт кратчайших путей между всеми парами вершин
+graph::Router<double> TransportRouter::BuildRouter(const Graph& graph) {
+    profiler::ScopedPhase phase("router_precompute"sv);
+    return graph::Router<double>(graph);
+}
+
 
 } // namespace router
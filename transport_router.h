@@ -1,13 +1,16 @@
 #pragma once
 
+#include <functional>
 #include <optional>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "graph.h"
 #include "router.h"
+#include "ranges.h"
 
 namespace router {
 
@@ -16,13 +19,27 @@ struct RoutingSettings {
     double bus_velocity;
 };
 
+struct RouteQuery {
+    std::string_view from;
+    std::string_view to;
+};
+
 class TransportRouter {
 public:
     TransportRouter(const catalogue::TransportCatalogue& catalogue,
             const RoutingSettings& routing_settings);
 
+    // Возвращает nullopt, если маршрута нет или одна из остановок неизвестна
     std::optional<domain::RouteInfo> BuildRoute(std::string_view from, std::string_view to) const;
 
+    // Маршрут для queries[i] записывается в results[i]. Запросы обрабатываются
+    // сгруппированными по начальной остановке: маршруты из одной вершины берутся
+    // из одной строки таблицы кратчайших путей. on_result, если задан, вызывается
+    // с индексом запроса сразу после записи его результата
+    void BuildRoutes(ranges::Span<const RouteQuery> queries,
+            ranges::Span<std::optional<domain::RouteInfo>> results,
+            const std::function<void(size_t)>& on_result = {}) const;
+
 private:
     struct RouteInfo {
         const std::string& stop_name;
@@ -44,11 +61,13 @@ private:
     double GetTripTimeFromGraph(size_t edge_id) const;
     double ComputeTime(const domain::Stop* from, const domain::Stop* to) const;
     size_t GetGraphVertexId(std::string_view name) const;
+    std::optional<size_t> FindGraphVertexId(std::string_view name) const;
 
     void AddGraphEdge(Graph& graph, Edge edge, RouteInfo route_info);
     void FillGraphWithStops();
     void FillGraphWithRoutes(Graph& graph);
     Graph CreateGraph();
+    static graph::Router<double> BuildRouter(const Graph& graph);
 };
 
 } // namespace router